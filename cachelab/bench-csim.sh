@@ -0,0 +1,44 @@
+#!/bin/sh
+#
+# bench-csim.sh - Simulation throughput of csim for each tag-match variant
+#
+#     Runs csim -T several times per configuration and reports the best
+#     rate, in millions of simulated accesses per second.
+#
+#     linux> make csim tracebin
+#     linux> ./bench-csim.sh [trace] [runs]
+#
+TRACE=${1:-traces/long.trace}
+RUNS=${2:-5}
+S=4
+B=5
+
+# Decode the text trace once so the timings measure the simulator
+BIN=$(mktemp /tmp/csim-bench.XXXXXX)
+trap 'rm -f "$BIN"' EXIT
+./tracebin "$TRACE" "$BIN" 2>/dev/null || exit 1
+
+printf "%-6s %12s %12s %12s\n" "E" "scalar" "sse4.1" "avx2"
+for E in 4 8 16; do
+    printf "%-6s" "$E"
+    for MATCH in scalar sse4.1 avx2; do
+        best=0
+        used=
+        i=0
+        while [ $i -lt "$RUNS" ]; do
+            out=$(CSIM_MATCH=$MATCH ./csim -T -s $S -E $E -b $B -t "$BIN" \
+                  2>&1 >/dev/null)
+            rate=$(echo "$out" | sed -n 's/.*: \([0-9.]*\) M accesses.*/\1/p')
+            used=$(echo "$out" | sed -n 's/.*(\(.*\) tag match).*/\1/p')
+            best=$(awk -v a="$rate" -v b="$best" 'BEGIN { print (a > b) ? a : b }')
+            i=$((i + 1))
+        done
+        if [ "$used" = "$MATCH" ]; then
+            printf " %12s" "$best"
+        else
+            printf " %12s" "n/a"
+        fi
+    done
+    printf "\n"
+done
+echo "(M accesses/s, best of $RUNS, -s $S -b $B, $(basename "$TRACE"))"
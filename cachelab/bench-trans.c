@@ -0,0 +1,340 @@
+/*
+ * bench-trans.c - Wall-clock throughput and simulated misses of the
+ *     kernels in transpose.c on large matrices
+ *
+ *     linux> ./bench-trans -M 4096 -N 4096
+ *     linux> ./bench-trans -M 8192 -N 8192 -s 6 -E 8 -b 6 -r 5
+ *
+ * Every kernel is linked twice. The copy built at -O2
+ * (transpose-native.o, its symbols renamed native_*) is timed, best of
+ * -r runs after a warm-up run that also checks its result. The copy in
+ * transpose-traced.o is run once with tracehook on and its accesses are
+ * simulated in-process with libcsim, on a cache of 2^s sets of E ways
+ * of 2^b bytes (default 6, 8, 6: a 32KB L1). A and B are laid out as
+ * tune-trans lays them out. Throughput counts the bytes of A read and
+ * of B written. -n skips the simulation, which is much slower than the
+ * kernels.
+ *
+ * With -j, transpose_parallel() is then timed on 1, 2, 4, ... up to -j
+ * threads, for the matrix and for it shrunk by 2, 4 and 8 on each side.
+ * Every run gets a fresh B that the pool first touches, so its pages
+ * sit with the threads that write them.
+ */
+#define _DEFAULT_SOURCE
+
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "libcsim.h"
+#include "tracehook.h"
+#include "transpose.h"
+
+#define MAX_DIM 32768
+#define MAX_THREADS 64
+
+/* B starts this far after A (rounded up to fit A) */
+#define B_ALIGN ((size_t)256 << 10)
+
+/* transpose.c at -O2, see the Makefile */
+void native_transpose_oblivious(int M, int N, int A[N][M], int B[M][N]);
+void native_transpose_tiled(int M, int N, int A[N][M], int B[M][N], int s,
+                            int E, int b);
+void native_transpose_avx2(int M, int N, int A[N][M], int B[M][N]);
+void native_transpose_sse(int M, int N, int A[N][M], int B[M][N]);
+Transpose_pool* native_transpose_pool_create(int threads);
+void native_transpose_pool_destroy(Transpose_pool* pool);
+void native_transpose_pool_touch(Transpose_pool* pool, int M, int N,
+                                 int B[M][N]);
+void native_transpose_parallel(Transpose_pool* pool, int M, int N,
+                               int A[N][M], int B[M][N]);
+
+typedef struct kernel {
+    const char* name;
+    void (*native)(int M, int N, int[N][M], int[M][N]);
+    void (*traced)(int M, int N, int[N][M], int[M][N]);
+} Kernel;
+
+/* The cache transpose_tiled is sized for and that is simulated */
+static int sim_s = 6, sim_E = 8, sim_b = 6;
+
+static void native_tiled(int M, int N, int A[N][M], int B[M][N]) {
+    native_transpose_tiled(M, N, A, B, sim_s, sim_E, sim_b);
+}
+
+static void traced_tiled(int M, int N, int A[N][M], int B[M][N]) {
+    transpose_tiled(M, N, A, B, sim_s, sim_E, sim_b);
+}
+
+static const Kernel kernels[] = {
+    {"oblivious", native_transpose_oblivious, transpose_oblivious},
+    {"tiled", native_tiled, traced_tiled},
+    {"sse", native_transpose_sse, transpose_sse},
+    {"avx2", native_transpose_avx2, transpose_avx2},
+};
+
+#define KERNEL_COUNT (int)(sizeof(kernels) / sizeof(kernels[0]))
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void simulate_access(const Access* access, void* arg) {
+    csim_access(arg, access->addr, access->size, access->op);
+}
+
+static void reset(int M, int N, int* A, int* B) {
+    for (size_t k = 0; k < (size_t)M * N; ++k) {
+        A[k] = (int)k;
+        B[k] = -1;
+    }
+}
+
+static bool is_transposed(int M, int N, const int* A, const int* B) {
+    for (int i = 0; i < N; ++i) {
+        for (int j = 0; j < M; ++j) {
+            if (B[(size_t)j * N + i] != A[(size_t)i * M + j]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/* time_kernel - Best seconds of runs runs, or -1 if the result is wrong */
+static double time_kernel(const Kernel* k, int M, int N, int* A, int* B,
+                          int runs) {
+    double best = -1;
+
+    reset(M, N, A, B);
+    k->native(M, N, (int (*)[M])A, (int (*)[N])B);
+    if (!is_transposed(M, N, A, B)) {
+        return -1;
+    }
+    for (int r = 0; r < runs; ++r) {
+        double start = now();
+        k->native(M, N, (int (*)[M])A, (int (*)[N])B);
+        double elapsed = now() - start;
+        if (best < 0 || elapsed < best) {
+            best = elapsed;
+        }
+    }
+    return best;
+}
+
+/* simulate_kernel - Misses of the traced copy on a cold cache */
+static long long simulate_kernel(const Kernel* k, int M, int N, int* A,
+                                 int* B, const char* policy) {
+    Csim* csim = csim_create(sim_s, sim_E, sim_b, policy);
+    Csim_stats stats;
+
+    reset(M, N, A, B);
+    tracehook_start(simulate_access, csim);
+    k->traced(M, N, (int (*)[M])A, (int (*)[N])B);
+    tracehook_stop();
+
+    csim_stats(csim, &stats);
+    csim_destroy(csim);
+    return is_transposed(M, N, A, B) ? stats.misses : -1;
+}
+
+/*
+ * time_parallel - GB/s of transpose_parallel() on threads threads, or -1
+ * if its result is wrong
+ */
+static double time_parallel(int M, int N, int threads, int runs) {
+    size_t matrix_bytes = (size_t)M * N * sizeof(int);
+    size_t b_offset = (matrix_bytes + B_ALIGN - 1) / B_ALIGN * B_ALIGN;
+    Transpose_pool* pool = native_transpose_pool_create(threads);
+    void* memory;
+    double best = -1;
+
+    if (!pool || posix_memalign(&memory, 4096, b_offset + matrix_bytes)) {
+        perror("bench-trans");
+        exit(EXIT_FAILURE);
+    }
+    int* A = memory;
+    int* B = (int*)((char*)memory + b_offset);
+
+    native_transpose_pool_touch(pool, M, N, (int (*)[N])B);
+    for (size_t k = 0; k < (size_t)M * N; ++k) {
+        A[k] = (int)k;
+    }
+    native_transpose_parallel(pool, M, N, (int (*)[M])A, (int (*)[N])B);
+    if (is_transposed(M, N, A, B)) {
+        for (int r = 0; r < runs; ++r) {
+            double start = now();
+            native_transpose_parallel(pool, M, N, (int (*)[M])A,
+                                      (int (*)[N])B);
+            double elapsed = now() - start;
+            if (best < 0 || elapsed < best) {
+                best = elapsed;
+            }
+        }
+    }
+
+    free(memory);
+    native_transpose_pool_destroy(pool);
+    return best < 0 ? -1 : 2.0 * matrix_bytes / best / 1e9;
+}
+
+/* scale_parallel - The -j table: sizes down, thread counts across */
+static void scale_parallel(int M, int N, int max_threads, int runs) {
+    printf("\ntranspose_parallel, GB/s\n%-13s", "size");
+    for (int t = 1; t < max_threads * 2; t *= 2) {
+        printf(" %8d", t < max_threads ? t : max_threads);
+    }
+    printf("\n");
+
+    for (int shift = 3; shift >= 0; --shift) {
+        int m = M >> shift;
+        int n = N >> shift;
+        if (m < 1 || n < 1) {
+            continue;
+        }
+        char size[32];
+        snprintf(size, sizeof(size), "%dx%d", n, m);
+        printf("%-13s", size);
+        for (int t = 1; t < max_threads * 2; t *= 2) {
+            int threads = t < max_threads ? t : max_threads;
+            double rate = time_parallel(m, n, threads, runs);
+            if (rate < 0) {
+                printf(" %8s", "wrong");
+            } else {
+                printf(" %8.2f", rate);
+            }
+            fflush(stdout);
+        }
+        printf("\n");
+    }
+}
+
+static void usage(FILE* out, const char* prog) {
+    fprintf(out, "Usage: %s [-hn] [-M <M> -N <N>] [-s <s> -E <E> -b <b>] "
+            "[-P <policy>] [-r <runs>]\n"
+            "       [-j <threads>]\n", prog);
+    fprintf(out, "Times the kernels of transpose.c on the N x M matrix "
+            "A[N][M] (default 4096 x 4096)\nand simulates them on a cache "
+            "of 2^s sets of E ways of 2^b bytes\n(default 6, 8, 6).\n"
+            "  -r  Timed runs per kernel, the best is reported "
+            "(default 3)\n"
+            "  -n  Do not simulate\n"
+            "  -j  Also time transpose_parallel() on up to this many "
+            "threads\n");
+}
+
+int main(int argc, char* argv[]) {
+    int M = 4096, N = 4096;
+    int runs = 3;
+    const char* policy = "lru";
+    bool simulate = true;
+    int max_threads = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "hnM:N:s:E:b:P:r:j:")) != -1) {
+        switch (opt) {
+            case 'M':
+                M = atoi(optarg);
+                break;
+            case 'N':
+                N = atoi(optarg);
+                break;
+            case 's':
+                sim_s = atoi(optarg);
+                break;
+            case 'E':
+                sim_E = atoi(optarg);
+                break;
+            case 'b':
+                sim_b = atoi(optarg);
+                break;
+            case 'P':
+                policy = optarg;
+                break;
+            case 'r':
+                runs = atoi(optarg);
+                break;
+            case 'n':
+                simulate = false;
+                break;
+            case 'j':
+                max_threads = atoi(optarg);
+                break;
+            case 'h':
+                usage(stdout, argv[0]);
+                return 0;
+            default:
+                usage(stderr, argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if (M < 1 || N < 1 || M > MAX_DIM || N > MAX_DIM || runs < 1 ||
+        max_threads < 0 || max_threads > MAX_THREADS) {
+        fprintf(stderr, "%s: -M and -N must be 1 to %d, -r at least 1, "
+                "-j at most %d\n", argv[0], MAX_DIM, MAX_THREADS);
+        usage(stderr, argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    Csim* probe = csim_create(sim_s, sim_E, sim_b, policy);
+    if (!probe) {
+        fprintf(stderr, "%s: bad cache or policy\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    csim_destroy(probe);
+
+    size_t matrix_bytes = (size_t)M * N * sizeof(int);
+    size_t b_offset = (matrix_bytes + B_ALIGN - 1) / B_ALIGN * B_ALIGN;
+    void* memory;
+    if (posix_memalign(&memory, 4096, b_offset + matrix_bytes)) {
+        perror("posix_memalign");
+        exit(EXIT_FAILURE);
+    }
+    int* A = memory;
+    int* B = (int*)((char*)memory + b_offset);
+    tracehook_watch(A, matrix_bytes);
+    tracehook_watch(B, matrix_bytes);
+
+    printf("%d x %d ints, ", N, M);
+    if (simulate) {
+        printf("simulated on s=%d E=%d b=%d (%s)\n", sim_s, sim_E, sim_b,
+               policy);
+    } else {
+        printf("not simulated\n");
+    }
+    printf("%-10s %10s %10s %12s\n", "kernel", "ms", "GB/s", "misses");
+    for (int k = 0; k < KERNEL_COUNT; ++k) {
+        double seconds = time_kernel(&kernels[k], M, N, A, B, runs);
+        printf("%-10s ", kernels[k].name);
+        if (seconds < 0) {
+            printf("%10s %10s", "wrong", "-");
+        } else {
+            printf("%10.2f %10.2f", seconds * 1e3,
+                   2.0 * matrix_bytes / seconds / 1e9);
+        }
+        if (simulate) {
+            long long misses = simulate_kernel(&kernels[k], M, N, A, B,
+                                               policy);
+            if (misses < 0) {
+                printf(" %12s\n", "wrong");
+            } else {
+                printf(" %12lld\n", misses);
+            }
+        } else {
+            printf(" %12s\n", "-");
+        }
+        fflush(stdout);
+    }
+
+    tracehook_unwatch();
+    free(memory);
+
+    if (max_threads > 0) {
+        scale_parallel(M, N, max_threads, runs);
+    }
+    return 0;
+}
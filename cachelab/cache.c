@@ -0,0 +1,952 @@
+/*
+ * cache.c - The cache simulation engine behind csim
+ */
+#define _DEFAULT_SOURCE
+
+#include "cache.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
+/* decoded accesses handed to the simulator at a time */
+#define BATCH_SIZE 4096
+
+/* tags compared per step; tag arrays are padded to a multiple of this */
+#define TAG_LANES 4
+
+/* SRRIP/BRRIP: 2-bit re-reference prediction values */
+#define RRPV_MAX 3
+
+/* BRRIP inserts with a long prediction once every BRRIP_LONG fills */
+#define BRRIP_LONG 32
+
+/* OPT: next use of a block that is never touched again */
+#define NEVER SIZE_MAX
+
+/* -j: entries per parser-to-worker ring (2^k) and per published chunk */
+#define RING_SIZE 65536
+#define STAGE_SIZE 256
+
+/*
+ * Single-producer single-consumer ring carrying one worker's accesses as
+ * (address | write); block offsets are irrelevant, so bit 0 is free. The
+ * producer owns head and the consumer owns tail, each on its own line.
+ */
+typedef struct ring {
+    size_t head __attribute__((aligned(64)));
+    bool done;
+    size_t tail __attribute__((aligned(64)));
+    size_t entries[RING_SIZE] __attribute__((aligned(64)));
+} Ring;
+
+/* A worker of the -j mode: the sets with index % threads == id */
+typedef struct shard {
+    Ring ring;
+    Cache cache;    /* view of the shared sets with private counters */
+    pthread_t thread;
+    size_t staged;
+    size_t stage[STAGE_SIZE];
+} Shard;
+
+/* Bitmask of the first count ways of tags[] that hold tag */
+typedef uint64_t (*match_fn)(const size_t* tags, int count, size_t tag);
+
+static match_fn match_tags;
+static pthread_once_t match_once = PTHREAD_ONCE_INIT;
+
+static size_t block_span(const Access* access, size_t block_bits);
+
+static void init_match(void) {
+    select_match();
+}
+
+void init_cache(Cache* cache, const Cache_config* config) {
+    size_t set_count = (size_t)1 << config->set_bits;
+    int asso = (int)config->asso;
+    size_t lanes = ((size_t)asso + TAG_LANES - 1) / TAG_LANES * TAG_LANES;
+    size_t words = ((size_t)asso + 63) / 64;
+    size_t hash_size = 0;
+
+    pthread_once(&match_once, init_match);
+
+    /* Keep the tag tables at most half full */
+    if (config->asso > SIMD_MAX_ASSO) {
+        for (hash_size = 1; hash_size < 2 * (size_t)asso; hash_size <<= 1) {
+        }
+    }
+
+    *cache = (Cache){
+        .config = *config,
+        .hash_mask = hash_size ? hash_size - 1 : 0,
+        .lanes = (int)lanes,
+        .rng = 0x2545f4914f6cdd1dull
+    };
+
+    cache->sets = calloc(set_count, sizeof(*cache->sets));
+    cache->all_tags = calloc(set_count * lanes, sizeof(*cache->all_tags));
+    cache->all_bits = calloc(2 * set_count * words, sizeof(*cache->all_bits));
+    cache->all_links = calloc(2 * set_count * asso, sizeof(int));
+    cache->all_meta = calloc(set_count * asso, sizeof(size_t));
+    cache->all_ways = hash_size ? calloc(set_count * hash_size, sizeof(int))
+                                : NULL;
+    if (!cache->sets || !cache->all_tags || !cache->all_bits ||
+        !cache->all_links || !cache->all_meta ||
+        (hash_size && !cache->all_ways)) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t s = 0; s < set_count; ++s) {
+        Set* set = &cache->sets[s];
+        set->tags = cache->all_tags + s * lanes;
+        set->valid = cache->all_bits + 2 * s * words;
+        set->dirty = set->valid + words;
+        set->prev = cache->all_links + 2 * s * asso;
+        set->next = set->prev + asso;
+        set->meta = cache->all_meta + s * asso;
+        set->ways = hash_size ? cache->all_ways + s * hash_size : NULL;
+        set->mru = 0;
+        set->lru = asso - 1;
+        for (int i = 0; i < asso; ++i) {
+            set->prev[i] = i - 1;
+            set->next[i] = i + 1 < asso ? i + 1 : -1;
+        }
+    }
+}
+
+void free_cache(Cache* cache) {
+    free(cache->all_ways);
+    free(cache->all_meta);
+    free(cache->all_links);
+    free(cache->all_bits);
+    free(cache->all_tags);
+    free(cache->sets);
+}
+
+static size_t hash_slot(size_t tag, size_t mask) {
+    return (size_t)((tag * 0x9e3779b97f4a7c15ull) >> 32) & mask;
+}
+
+static uint64_t match_scalar(const size_t* tags, int count, size_t tag) {
+    uint64_t mask = 0;
+    for (int i = 0; i < count; ++i) {
+        mask |= (uint64_t)(tags[i] == tag) << i;
+    }
+    return mask;
+}
+
+#ifdef HAVE_X86_SIMD
+__attribute__((target("sse4.1")))
+static uint64_t match_sse41(const size_t* tags, int count, size_t tag) {
+    __m128i key = _mm_set1_epi64x((long long)tag);
+    uint64_t mask = 0;
+    for (int i = 0; i < count; i += 2) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(tags + i));
+        __m128i eq = _mm_cmpeq_epi64(v, key);
+        mask |= (uint64_t)_mm_movemask_pd(_mm_castsi128_pd(eq)) << i;
+    }
+    return mask;
+}
+
+__attribute__((target("avx2")))
+static uint64_t match_avx2(const size_t* tags, int count, size_t tag) {
+    __m256i key = _mm256_set1_epi64x((long long)tag);
+    uint64_t mask = 0;
+    for (int i = 0; i < count; i += 4) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(tags + i));
+        __m256i eq = _mm256_cmpeq_epi64(v, key);
+        mask |= (uint64_t)_mm256_movemask_pd(_mm256_castsi256_pd(eq)) << i;
+    }
+    return mask;
+}
+#endif
+
+const char* select_match(void) {
+    const char* force = getenv("CSIM_MATCH");
+
+    match_tags = match_scalar;
+#ifdef HAVE_X86_SIMD
+    __builtin_cpu_init();
+    if ((!force || strcmp(force, "avx2") == 0) &&
+        __builtin_cpu_supports("avx2")) {
+        match_tags = match_avx2;
+        return "avx2";
+    }
+    if ((!force || strcmp(force, "sse4.1") == 0) &&
+        __builtin_cpu_supports("sse4.1")) {
+        match_tags = match_sse41;
+        return "sse4.1";
+    }
+#endif
+    return "scalar";
+}
+
+/* find_way - Return the way holding tag, or -1 */
+static int find_way(const Set* set, size_t tag, const Cache* cache) {
+    if (!set->ways) {
+        uint64_t hits = match_tags(set->tags, cache->lanes, tag) &
+                        set->valid[0];
+        return hits ? __builtin_ctzll(hits) : -1;
+    }
+
+    size_t mask = cache->hash_mask;
+    for (size_t i = hash_slot(tag, mask); set->ways[i]; i = (i + 1) & mask) {
+        int way = set->ways[i] - 1;
+        if (set->tags[way] == tag) {
+            return way;
+        }
+    }
+    return -1;
+}
+
+static void hash_insert(Set* set, size_t tag, int way, size_t mask) {
+    size_t i = hash_slot(tag, mask);
+    while (set->ways[i]) {
+        i = (i + 1) & mask;
+    }
+    set->ways[i] = way + 1;
+}
+
+/*
+ * hash_remove - Delete tag from a linear-probing table, shifting later
+ * entries of the probe run back so no tombstones are needed.
+ */
+static void hash_remove(Set* set, size_t tag, size_t mask) {
+    size_t i = hash_slot(tag, mask);
+    while (set->tags[set->ways[i] - 1] != tag) {
+        i = (i + 1) & mask;
+    }
+
+    for (size_t j = (i + 1) & mask; set->ways[j]; j = (j + 1) & mask) {
+        size_t home = hash_slot(set->tags[set->ways[j] - 1], mask);
+        /* move j into the hole at i unless its home lies in (i, j] */
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            set->ways[i] = set->ways[j];
+            i = j;
+        }
+    }
+    set->ways[i] = 0;
+}
+
+/* touch - Move way to the MRU end of its set's recency list */
+static void touch(Set* set, int way) {
+    if (set->mru == way) {
+        return;
+    }
+
+    int prev = set->prev[way];
+    int next = set->next[way];
+    set->next[prev] = next;
+    if (next != -1) {
+        set->prev[next] = prev;
+    } else {
+        set->lru = prev;
+    }
+
+    set->prev[way] = -1;
+    set->next[way] = set->mru;
+    set->prev[set->mru] = way;
+    set->mru = way;
+}
+
+
+static uint64_t next_random(Cache* cache) {
+    cache->rng ^= cache->rng >> 12;
+    cache->rng ^= cache->rng << 25;
+    cache->rng ^= cache->rng >> 27;
+    return cache->rng * 2685821657736338717ull;
+}
+
+/* LRU: promote on every access, evict the tail of the recency list */
+static void lru_touch(Cache* cache, Set* set, int way) {
+    touch(set, way);
+}
+
+static int list_victim(Cache* cache, Set* set) {
+    return set->lru;
+}
+
+/* FIFO: the same list, ordered by fill only */
+static void fifo_hit(Cache* cache, Set* set, int way) {
+}
+
+static void random_update(Cache* cache, Set* set, int way) {
+}
+
+static int random_victim(Cache* cache, Set* set) {
+    return (int)(next_random(cache) % cache->config.asso);
+}
+
+/*
+ * Tree-PLRU: meta[n] for n in 1..E-1 is the bit of internal node n of a
+ * binary tree over the ways (children 2n and 2n+1, leaves E..2E-1) and
+ * points at the half holding the pseudo-LRU way.
+ */
+static void plru_touch(Cache* cache, Set* set, int way) {
+    size_t node = cache->config.asso + way;
+    for (; node > 1; node >>= 1) {
+        set->meta[node >> 1] = !(node & 1);
+    }
+}
+
+static int plru_victim(Cache* cache, Set* set) {
+    size_t node = 1;
+    while (node < cache->config.asso) {
+        node = 2 * node + set->meta[node];
+    }
+    return (int)(node - cache->config.asso);
+}
+
+/*
+ * SRRIP/BRRIP (Jaleel et al., ISCA 2010): meta[] holds each way's
+ * re-reference prediction. Hits predict near-immediate reuse; SRRIP fills
+ * with a long prediction, BRRIP mostly with a distant one so that scans
+ * do not flush the set.
+ */
+static void rrip_hit(Cache* cache, Set* set, int way) {
+    set->meta[way] = 0;
+}
+
+static void srrip_fill(Cache* cache, Set* set, int way) {
+    set->meta[way] = RRPV_MAX - 1;
+}
+
+static void brrip_fill(Cache* cache, Set* set, int way) {
+    bool rare = next_random(cache) % BRRIP_LONG == 0;
+    set->meta[way] = rare ? RRPV_MAX - 1 : RRPV_MAX;
+}
+
+static int rrip_victim(Cache* cache, Set* set) {
+    size_t oldest = 0;
+    int way = 0;
+
+    for (int i = 0; i < cache->config.asso; ++i) {
+        if (set->meta[i] > oldest) {
+            oldest = set->meta[i];
+            way = i;
+        }
+    }
+    /* Age the whole set until the victim's prediction is distant */
+    for (int i = 0; oldest < RRPV_MAX && i < cache->config.asso; ++i) {
+        set->meta[i] += RRPV_MAX - oldest;
+    }
+    return way;
+}
+
+/*
+ * OPT (Belady): meta[] holds the time of each block's next use, taken
+ * from the next-use index built before the simulation; evict the block
+ * used furthest in the future.
+ */
+static void opt_update(Cache* cache, Set* set, int way) {
+    set->meta[way] = cache->next_use[cache->now];
+}
+
+static int opt_victim(Cache* cache, Set* set) {
+    int way = 0;
+
+    for (int i = 1; i < cache->config.asso; ++i) {
+        if (set->meta[i] > set->meta[way]) {
+            way = i;
+        }
+    }
+    return way;
+}
+
+static const Policy policies[] = {
+    {"lru", lru_touch, lru_touch, list_victim, true},
+    {"fifo", fifo_hit, lru_touch, list_victim, true},
+    {"random", random_update, random_update, random_victim, false},
+    {"plru", plru_touch, plru_touch, plru_victim, true},
+    {"srrip", rrip_hit, srrip_fill, rrip_victim, true},
+    {"brrip", rrip_hit, brrip_fill, rrip_victim, false},
+    {"opt", opt_update, opt_update, opt_victim, false},
+};
+
+const Policy* find_policy(const char* name) {
+    for (size_t i = 0; i < sizeof(policies) / sizeof(*policies); ++i) {
+        if (strcmp(policies[i].name, name) == 0) {
+            return &policies[i];
+        }
+    }
+    return NULL;
+}
+
+/* free_way - Return the lowest invalid way of the set, or -1 */
+static int free_way(const Cache* cache, const Set* set) {
+    size_t words = (cache->config.asso + 63) / 64;
+
+    for (size_t i = 0; i < words; ++i) {
+        uint64_t free = ~set->valid[i];
+        if (i == words - 1 && cache->config.asso % 64) {
+            free &= ((uint64_t)1 << (cache->config.asso % 64)) - 1;
+        }
+        if (free) {
+            return (int)(i * 64) + __builtin_ctzll(free);
+        }
+    }
+    return -1;
+}
+
+static bool test_bit(const uint64_t* bits, int way) {
+    return (bits[way / 64] >> (way % 64)) & 1;
+}
+
+static void put_bit(uint64_t* bits, int way, bool value) {
+    uint64_t bit = (uint64_t)1 << (way % 64);
+    bits[way / 64] = value ? bits[way / 64] | bit : bits[way / 64] & ~bit;
+}
+
+static Set* set_of(const Cache* cache, size_t addr, size_t* tag) {
+    size_t set_bits = cache->config.set_bits;
+    size_t block_bits = cache->config.block_bits;
+
+    *tag = addr >> (block_bits + set_bits);
+    return &cache->sets[(addr >> block_bits) & (((size_t)1 << set_bits) - 1)];
+}
+
+/*
+ * invalidate - Drop the block holding addr, if present. Returns true if
+ * the dropped block was dirty.
+ */
+static bool invalidate(Cache* cache, size_t addr) {
+    size_t tag;
+    Set* set = set_of(cache, addr, &tag);
+    int way = find_way(set, tag, cache);
+
+    if (way == -1) {
+        return false;
+    }
+
+    bool dirty = test_bit(set->dirty, way);
+    put_bit(set->valid, way, false);
+    put_bit(set->dirty, way, false);
+    if (set->ways) {
+        hash_remove(set, tag, cache->hash_mask);
+    }
+    return dirty;
+}
+
+static bool access_level(Hierarchy* h, int level, size_t addr, bool write,
+                         int size);
+
+/* fetch_below - Read the level's block at addr from the next level down */
+static bool fetch_below(Hierarchy* h, int level, size_t addr) {
+    Cache* cache = &h->levels[level];
+    cache->bytes_read += (long long)1 << cache->config.block_bits;
+    return access_level(h, level + 1, addr, false, 0);
+}
+
+/* write_below - Write size bytes at addr to the next level down */
+static void write_below(Hierarchy* h, int level, size_t addr, int size) {
+    h->levels[level].bytes_written += size;
+    access_level(h, level + 1, addr, true, size);
+}
+static void install(Hierarchy* h, int level, size_t addr, bool dirty);
+
+/*
+ * back_invalidate - Remove every copy of the level's block at addr from
+ * the levels above it. Returns true if any of those copies was dirty.
+ */
+static bool back_invalidate(Hierarchy* h, int level, size_t addr) {
+    size_t size = (size_t)1 << h->levels[level].config.block_bits;
+    bool dirty = false;
+
+    for (int i = 0; i < level; ++i) {
+        size_t step = (size_t)1 << h->levels[i].config.block_bits;
+        for (size_t a = addr; a < addr + size; a += step) {
+            dirty |= invalidate(&h->levels[i], a);
+        }
+    }
+    return dirty;
+}
+
+/*
+ * evict - Send a block evicted from the level downwards: into the next
+ * level if that one is exclusive (clean or not), else as a write if dirty.
+ */
+static void evict(Hierarchy* h, int level, size_t addr, bool dirty) {
+    int block_size = 1 << h->levels[level].config.block_bits;
+    if (dirty) {
+        ++h->levels[level].writebacks;
+    }
+
+    int below = level + 1;
+    if (below < h->count && h->levels[below].config.inclusion == EXCLUSIVE) {
+        size_t tag;
+        Cache* cache = &h->levels[below];
+        h->levels[level].bytes_written += block_size;
+        Set* set = set_of(cache, addr, &tag);
+        int way = find_way(set, tag, cache);
+        if (way == -1) {
+            install(h, below, addr, dirty);
+        } else if (dirty) {
+            put_bit(set->dirty, way, true);
+        }
+    } else if (dirty) {
+        write_below(h, level, addr, block_size);
+    }
+}
+
+/*
+ * install - Place the block at addr in a free way, or else in the way the
+ * policy picks, evicting the block there (and, for inclusive levels, its
+ * copies above).
+ */
+static void install(Hierarchy* h, int level, size_t addr, bool dirty) {
+    Cache* cache = &h->levels[level];
+    size_t tag;
+    Set* set = set_of(cache, addr, &tag);
+    int way = free_way(cache, set);
+
+    if (way == -1) {
+        way = cache->config.policy->victim(cache, set);
+        size_t shift = cache->config.set_bits + cache->config.block_bits;
+        size_t block_mask = ((size_t)1 << cache->config.block_bits) - 1;
+        size_t victim = (set->tags[way] << shift) | (addr & ~block_mask &
+                        (((size_t)1 << shift) - 1));
+        bool victim_dirty = test_bit(set->dirty, way);
+
+        ++cache->evictions;
+        if (set->ways) {
+            hash_remove(set, set->tags[way], cache->hash_mask);
+        }
+        put_bit(set->valid, way, false);
+        if (level > 0 && cache->config.inclusion == INCLUSIVE) {
+            victim_dirty |= back_invalidate(h, level, victim);
+        }
+        evict(h, level, victim, victim_dirty);
+    }
+
+    set->tags[way] = tag;
+    put_bit(set->valid, way, true);
+    put_bit(set->dirty, way, dirty);
+    if (set->ways) {
+        hash_insert(set, tag, way, cache->hash_mask);
+    }
+    cache->config.policy->fill(cache, set, way);
+}
+
+/*
+ * access_level - A read (block fetch) or write of size bytes at addr
+ * arriving at the given level from the level above, or from the CPU for
+ * level 0. Returns true if the block handed up is dirty, which only
+ * happens when an exclusive level gives up a modified block.
+ */
+static bool access_level(Hierarchy* h, int level, size_t addr, bool write,
+                         int size) {
+    if (level == h->count) {
+        return false;   /* memory */
+    }
+
+    Cache* cache = &h->levels[level];
+    const Cache_config* config = &cache->config;
+    bool exclusive = level > 0 && config->inclusion == EXCLUSIVE;
+    size_t tag;
+    Set* set = set_of(cache, addr, &tag);
+    int way = find_way(set, tag, cache);
+
+    if (way != -1) {
+        ++cache->hits;
+        if (exclusive && !write) {
+            /* The block moves up to the level that asked for it */
+            return invalidate(cache, addr);
+        }
+        config->policy->hit(cache, set, way);
+        if (write) {
+            if (config->write_back) {
+                put_bit(set->dirty, way, true);
+            } else {
+                write_below(h, level, addr, size);
+            }
+        }
+        return false;
+    }
+
+    ++cache->misses;
+    if (write && !config->write_allocate) {
+        write_below(h, level, addr, size);
+        return false;
+    }
+
+    bool dirty = fetch_below(h, level, addr);
+    if (exclusive && !write) {
+        return dirty;
+    }
+    install(h, level, addr, dirty || (write && config->write_back));
+    if (write && !config->write_back) {
+        write_below(h, level, addr, size);
+    }
+    return false;
+}
+
+void init_classifier(Classifier* classes, const Cache_config* config) {
+    Cache_config shadow = *config;
+
+    shadow.set_bits = 0;
+    shadow.asso = ((size_t)1 << config->set_bits) * config->asso;
+    shadow.inclusion = NINE;
+    shadow.policy = find_policy("lru");
+
+    *classes = (Classifier){.seen_mask = 1023};
+    init_cache(&classes->shadow, &shadow);
+    classes->shadow_levels = (Hierarchy){.levels = &classes->shadow,
+                                         .count = 1};
+    classes->seen = calloc(classes->seen_mask + 1, sizeof(size_t));
+    if (!classes->seen) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void free_classifier(Classifier* classes) {
+    free(classes->seen);
+    free_cache(&classes->shadow);
+}
+
+/* first_touch - Record an access to block; true if it is the first */
+static bool first_touch(Classifier* classes, size_t block) {
+    size_t key = block + 1;
+    size_t mask = classes->seen_mask;
+    size_t slot = hash_slot(key, mask);
+
+    while (classes->seen[slot] && classes->seen[slot] != key) {
+        slot = (slot + 1) & mask;
+    }
+    if (classes->seen[slot]) {
+        return false;
+    }
+    classes->seen[slot] = key;
+
+    /* Keep the table at most half full */
+    if (2 * ++classes->seen_count > mask + 1) {
+        size_t* old = classes->seen;
+        size_t bigger = 2 * (mask + 1);
+        classes->seen = calloc(bigger, sizeof(size_t));
+        if (!classes->seen) {
+            perror("calloc");
+            exit(EXIT_FAILURE);
+        }
+        classes->seen_mask = bigger - 1;
+        for (size_t i = 0; i <= mask; ++i) {
+            if (old[i]) {
+                slot = hash_slot(old[i], bigger - 1);
+                while (classes->seen[slot]) {
+                    slot = (slot + 1) & (bigger - 1);
+                }
+                classes->seen[slot] = old[i];
+            }
+        }
+        free(old);
+    }
+    return true;
+}
+
+/* classify - Run an L1 access through the shadow and count its miss */
+static void classify(Classifier* classes, size_t addr, bool write, int size,
+                     bool missed) {
+    bool first = first_touch(classes,
+                             addr >> classes->shadow.config.block_bits);
+    long long shadow_misses = classes->shadow.misses;
+
+    access_level(&classes->shadow_levels, 0, addr, write, size);
+    if (!missed) {
+        return;
+    }
+    if (first) {
+        ++classes->compulsory;
+    } else if (classes->shadow.misses != shadow_misses) {
+        ++classes->capacity;
+    } else {
+        ++classes->conflict;
+    }
+}
+
+/* cpu_access - An access by the CPU, counted in L1 access time */
+static void cpu_access(Hierarchy* h, size_t addr, bool write, int size) {
+    long long misses = h->levels[0].misses;
+
+    access_level(h, 0, addr, write, size);
+    if (h->classes) {
+        classify(h->classes, addr, write, size,
+                 h->levels[0].misses != misses);
+    }
+    ++h->levels[0].now;
+}
+
+/*
+ * block_span - Number of 2^block_bits byte blocks the access touches
+ * (a zero-size access still touches the block holding its address)
+ */
+static size_t block_span(const Access* access, size_t block_bits) {
+    size_t size = access->size > 0 ? (size_t)access->size : 1;
+    return ((access->addr + size - 1) >> block_bits) -
+           (access->addr >> block_bits) + 1;
+}
+
+/* cpu_accesses - cpu_access for each L1 block piece of the access */
+static void cpu_accesses(Hierarchy* h, const Access* access, bool write) {
+    size_t block_bits = h->levels[0].config.block_bits;
+    size_t addr = access->addr;
+    size_t end = addr + (access->size > 0 ? (size_t)access->size : 1);
+
+    while (addr < end) {
+        size_t next = ((addr >> block_bits) + 1) << block_bits;
+        size_t piece_end = next < end ? next : end;
+        cpu_access(h, addr, write, (int)(piece_end - addr));
+        addr = piece_end;
+    }
+}
+
+void update_cache(const Access* access, Hierarchy* h) {
+    size_t addr = access->addr;
+    int size = access->size;
+
+    if (h->split && access->op != 'I' &&
+        block_span(access, h->levels[0].config.block_bits) > 1) {
+        ++h->straddles;
+        cpu_accesses(h, access, access->op == 'S');
+        if (access->op == 'M') {
+            cpu_accesses(h, access, true);
+        }
+        return;
+    }
+
+    switch (access->op) {
+        case 'L':
+            cpu_access(h, addr, false, size);
+            break;
+
+        case 'S':
+            cpu_access(h, addr, true, size);
+            break;
+
+        case 'M':
+            cpu_access(h, addr, false, size);
+            cpu_access(h, addr, true, size);
+            break;
+    }
+}
+
+void simulate_batch(const Access* batch, size_t count, Hierarchy* h) {
+    for (size_t i = 0; i < count; ++i) {
+        update_cache(&batch[i], h);
+    }
+}
+
+/*
+ * build_next_use - Read the whole trace ahead of the simulation and, for
+ * each cache access it makes (two for M, and one per block if split),
+ * find the index of the next access to the same block of 2^block_bits
+ * bytes, or NEVER.
+ */
+static size_t* build_next_use(const char* filename, size_t block_bits,
+                              bool split) {
+    Trace_reader* reader = trace_open(filename);
+    Access batch[BATCH_SIZE];
+    size_t count;
+    size_t n = 0;
+    size_t capacity = 1 << 16;
+    size_t* blocks = malloc(capacity * sizeof(*blocks));
+
+    while (blocks && (count = trace_read(reader, batch, BATCH_SIZE)) > 0) {
+        for (size_t i = 0; i < count; ++i) {
+            int times = batch[i].op == 'M' ? 2 : batch[i].op != 'I';
+            size_t span = split ? block_span(&batch[i], block_bits) : 1;
+            for (int k = 0; k < times && blocks; ++k) {
+                for (size_t j = 0; j < span; ++j) {
+                    if (n == capacity) {
+                        capacity *= 2;
+                        blocks = realloc(blocks, capacity * sizeof(*blocks));
+                        if (!blocks) {
+                            break;
+                        }
+                    }
+                    blocks[n++] = (batch[i].addr >> block_bits) + j;
+                }
+            }
+        }
+    }
+    trace_close(reader);
+
+    /* block + 1 -> index of its latest access seen, walking backwards */
+    size_t size = 16;
+    while (size < 2 * n) {
+        size <<= 1;
+    }
+    size_t* keys = calloc(size, sizeof(*keys));
+    size_t* last = malloc(size * sizeof(*last));
+    if (!blocks || !keys || !last) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = n; i-- > 0;) {
+        size_t key = blocks[i] + 1;
+        size_t slot = hash_slot(key, size - 1);
+        while (keys[slot] && keys[slot] != key) {
+            slot = (slot + 1) & (size - 1);
+        }
+        blocks[i] = keys[slot] ? last[slot] : NEVER;
+        keys[slot] = key;
+        last[slot] = i;
+    }
+
+    free(last);
+    free(keys);
+    return blocks;
+}
+
+void simulate_trace(const char* filename, Hierarchy* h) {
+    Cache* l1 = &h->levels[0];
+    size_t* next_use = NULL;
+
+    if (strcmp(l1->config.policy->name, "opt") == 0) {
+        next_use = build_next_use(filename, l1->config.block_bits,
+                                  h->split);
+        l1->next_use = next_use;
+    }
+
+    Trace_reader* reader = trace_open(filename);
+    Access batch[BATCH_SIZE];
+    size_t count;
+
+    while ((count = trace_read(reader, batch, BATCH_SIZE)) > 0) {
+        simulate_batch(batch, count, h);
+    }
+
+    trace_close(reader);
+    free(next_use);
+}
+
+static void* shard_main(void* arg) {
+    Shard* shard = arg;
+    Ring* ring = &shard->ring;
+    Hierarchy h = {.levels = &shard->cache, .count = 1};
+    size_t tail = 0;
+
+    for (;;) {
+        size_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        if (head == tail) {
+            /* done is set after the last head update, so recheck head */
+            if (__atomic_load_n(&ring->done, __ATOMIC_ACQUIRE)) {
+                if (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == tail) {
+                    break;
+                }
+            } else {
+                sched_yield();
+            }
+            continue;
+        }
+
+        for (; tail != head; ++tail) {
+            size_t entry = ring->entries[tail & (RING_SIZE - 1)];
+            access_level(&h, 0, entry & ~(size_t)1, entry & 1, 0);
+        }
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+/* publish - Hand the shard's staged accesses to its worker */
+static void publish(Shard* shard) {
+    Ring* ring = &shard->ring;
+    size_t head = ring->head;
+
+    while (head + shard->staged -
+           __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) > RING_SIZE) {
+        sched_yield();
+    }
+    for (size_t i = 0; i < shard->staged; ++i) {
+        ring->entries[(head + i) & (RING_SIZE - 1)] = shard->stage[i];
+    }
+    __atomic_store_n(&ring->head, head + shard->staged, __ATOMIC_RELEASE);
+    shard->staged = 0;
+}
+
+static void stage(Shard* shard, size_t addr, bool write) {
+    shard->stage[shard->staged++] = (addr & ~(size_t)1) | write;
+    if (shard->staged == STAGE_SIZE) {
+        publish(shard);
+    }
+}
+
+/*
+ * simulate_sharded - Simulate a single-level cache on several threads.
+ * Sets never interact under a per-set policy, so this thread parses the
+ * trace and deals each access to the worker owning its set; only the
+ * order within a set matters, and the ring keeps it.
+ */
+void simulate_sharded(const char* filename, Hierarchy* h,
+                             int threads) {
+    Cache* cache = &h->levels[0];
+    size_t set_mask = ((size_t)1 << cache->config.set_bits) - 1;
+    size_t block_bits = cache->config.block_bits;
+
+    if ((size_t)threads > set_mask + 1) {
+        threads = (int)(set_mask + 1);
+    }
+
+    Shard* shards = NULL;
+    if (posix_memalign((void**)&shards, 64, threads * sizeof(*shards))) {
+        perror("posix_memalign");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < threads; ++i) {
+        Shard* shard = &shards[i];
+        shard->ring.head = 0;
+        shard->ring.tail = 0;
+        shard->ring.done = false;
+        shard->staged = 0;
+        shard->cache = *cache;
+        pthread_create(&shard->thread, NULL, shard_main, shard);
+    }
+
+    Trace_reader* reader = trace_open(filename);
+    Access batch[BATCH_SIZE];
+    size_t count;
+
+    while ((count = trace_read(reader, batch, BATCH_SIZE)) > 0) {
+        for (size_t i = 0; i < count; ++i) {
+            char op = batch[i].op;
+            size_t span = 1;
+            if (op == 'I') {
+                continue;
+            }
+            if (h->split && (span = block_span(&batch[i], block_bits)) > 1) {
+                ++h->straddles;
+            }
+            for (int write = op == 'S'; write <= (op != 'L'); ++write) {
+                for (size_t j = 0; j < span; ++j) {
+                    size_t block = (batch[i].addr >> block_bits) + j;
+                    size_t addr = j ? block << block_bits : batch[i].addr;
+                    stage(&shards[(block & set_mask) % threads], addr, write);
+                }
+            }
+        }
+    }
+    trace_close(reader);
+
+    for (int i = 0; i < threads; ++i) {
+        publish(&shards[i]);
+        __atomic_store_n(&shards[i].ring.done, true, __ATOMIC_RELEASE);
+    }
+    for (int i = 0; i < threads; ++i) {
+        pthread_join(shards[i].thread, NULL);
+        cache->hits += shards[i].cache.hits;
+        cache->misses += shards[i].cache.misses;
+        cache->evictions += shards[i].cache.evictions;
+        cache->writebacks += shards[i].cache.writebacks;
+        cache->bytes_read += shards[i].cache.bytes_read;
+        cache->bytes_written += shards[i].cache.bytes_written;
+    }
+    free(shards);
+}
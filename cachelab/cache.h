@@ -0,0 +1,177 @@
+/*
+ * cache.h - The cache simulation engine behind csim
+ *
+ * A Hierarchy is a list of cache levels from L1 down, with memory below
+ * the last. Accesses go in through update_cache (one decoded trace
+ * record at a time) or simulate_trace/simulate_sharded (a whole trace
+ * file); each level counts its own hits, misses, evictions and traffic.
+ */
+
+#ifndef CACHELAB_CACHE_H
+#define CACHELAB_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tracefile.h"
+
+/*
+ * Sets are stored as structures of arrays so that a lookup can compare
+ * the whole tag array at once: tags[] holds the tag of every way (padded
+ * to TAG_LANES), valid[] and dirty[] are bitmasks over the ways. Sets
+ * with more than SIMD_MAX_ASSO ways look tags up through an
+ * open-addressing table from tag to way + 1 (0 marks an empty slot).
+ *
+ * Replacement state belongs to the level's policy: prev[] and next[] link
+ * the ways into a recency (or insertion) list, most recent first, and
+ * meta[] holds one word per way (tree bits, RRPVs or next-use times).
+ * Invalid ways are always filled first, lowest way first.
+ */
+typedef struct set {
+    size_t* tags;
+    uint64_t* valid;
+    uint64_t* dirty;
+    int* prev;  /* towards the most recently used way */
+    int* next;  /* towards the least recently used way */
+    int mru;
+    int lru;
+    size_t* meta;
+    int* ways;
+} Set;
+
+typedef struct cache Cache;
+
+/*
+ * A replacement policy: hit and fill update the set's state for an
+ * access to way, victim picks the way to evict from a full set. per_set
+ * is true when a set's decisions depend on nothing but its own accesses,
+ * so sets can be simulated independently.
+ */
+typedef struct policy {
+    const char* name;
+    void (*hit)(Cache* cache, Set* set, int way);
+    void (*fill)(Cache* cache, Set* set, int way);
+    int (*victim)(Cache* cache, Set* set);
+    bool per_set;
+} Policy;
+
+/* How a level relates to the levels above it (closer to the CPU) */
+typedef enum inclusion {
+    NINE,       /* neither inclusive nor exclusive */
+    INCLUSIVE,  /* holds every block above it; evictions back-invalidate */
+    EXCLUSIVE   /* holds only victims of the level above */
+} Inclusion;
+
+typedef struct cache_config {
+    size_t set_bits;
+    size_t asso;
+    size_t block_bits;
+    bool verbose;
+    Inclusion inclusion;
+    bool write_back;        /* else write-through */
+    bool write_allocate;    /* else no-write-allocate */
+    const Policy* policy;
+} Cache_config;
+
+typedef struct cache {
+    Set* sets;
+    Cache_config config;
+    size_t hash_mask;   /* slots per set table - 1, 0 without tables */
+    int lanes;          /* ways compared per lookup, asso rounded up */
+    long long hits;
+    long long misses;
+    long long evictions;
+    long long writebacks;       /* dirty evictions */
+    long long bytes_read;       /* from the next level down */
+    long long bytes_written;    /* to the next level down */
+
+    uint64_t rng;               /* random and BRRIP state */
+    const size_t* next_use;     /* OPT: next access to each access's block */
+    size_t now;                 /* OPT: index of the current access */
+
+    /* backing storage of the sets */
+    size_t* all_tags;
+    uint64_t* all_bits;
+    int* all_links;
+    size_t* all_meta;
+    int* all_ways;
+} Cache;
+
+typedef struct classifier Classifier;
+
+/*
+ * Cache levels from L1 (levels[0]) down; memory sits below the last.
+ * With split set, an access crossing L1 block boundaries becomes one
+ * access per block it touches, and straddles counts such accesses. If
+ * classes is set, L1's misses are sorted into it.
+ */
+typedef struct hierarchy {
+    Cache* levels;
+    int count;
+    bool split;
+    long long straddles;
+    Classifier* classes;
+} Hierarchy;
+
+/*
+ * The three Cs of L1's misses. A miss is compulsory if its block was
+ * never accessed before. Otherwise it is a capacity miss if shadow, a
+ * fully associative LRU cache with as many blocks as L1 that sees the
+ * same accesses, misses as well, and a conflict miss if shadow hits.
+ */
+struct classifier {
+    Cache shadow;
+    Hierarchy shadow_levels;
+    size_t* seen;       /* blocks + 1 accessed so far, open addressing */
+    size_t seen_mask;
+    size_t seen_count;
+    long long compulsory;
+    long long capacity;
+    long long conflict;
+};
+
+/* widest associativity looked up by comparing the whole tag array */
+#define SIMD_MAX_ASSO 64
+
+#define MAX_LEVELS 8
+
+/* most threads simulate_sharded will use */
+#define MAX_THREADS 64
+
+/* find_policy - The replacement policy called name, or NULL */
+const Policy* find_policy(const char* name);
+
+/*
+ * select_match - Pick the widest tag comparison the CPU supports. The
+ * CSIM_MATCH environment variable (scalar, sse4.1, avx2) restricts the
+ * choice to one variant, for benchmarking. Returns the name of the
+ * variant in use. init_cache calls it if nobody has yet.
+ */
+const char* select_match(void);
+
+/* init_cache - Set up an empty level; exits if out of memory */
+void init_cache(Cache* cache, const Cache_config* config);
+void free_cache(Cache* cache);
+
+/*
+ * init_classifier - Empty 3C counters for an L1 with config; exits if
+ * out of memory
+ */
+void init_classifier(Classifier* classes, const Cache_config* config);
+void free_classifier(Classifier* classes);
+
+/* update_cache - Simulate one trace record; I records are ignored */
+void update_cache(const Access* access, Hierarchy* h);
+void simulate_batch(const Access* batch, size_t count, Hierarchy* h);
+
+/* simulate_trace - Simulate a whole trace file (the only way to use opt) */
+void simulate_trace(const char* filename, Hierarchy* h);
+
+/*
+ * simulate_sharded - Simulate a trace on a single write-back,
+ * write-allocate level with a per-set policy, on up to threads threads
+ */
+void simulate_sharded(const char* filename, Hierarchy* h, int threads);
+
+#endif /* CACHELAB_CACHE_H */
@@ -14,15 +14,38 @@ int func_counter = 0;
  * printSummary - Summarize the cache simulation statistics. Student cache simulators
  *                must call this function in order to be properly autograded. 
  */
-void printSummary(int hits, int misses, int evictions)
+void printSummary(long long hits, long long misses, long long evictions)
 {
-    printf("hits:%d misses:%d evictions:%d\n", hits, misses, evictions);
+    printf("hits:%lld misses:%lld evictions:%lld\n", hits, misses, evictions);
     FILE* output_fp = fopen(".csim_results", "w");
     assert(output_fp);
-    fprintf(output_fp, "%d %d %d\n", hits, misses, evictions);
+    fprintf(output_fp, "%lld %lld %lld\n", hits, misses, evictions);
     fclose(output_fp);
 }
 
+/*
+ * printLevelSummary - Summarize one level of a multi-level simulation.
+ *     Only printed; the autograders read the L1 numbers written by
+ *     printSummary.
+ */
+void printLevelSummary(int level, long long hits, long long misses,
+                       long long evictions, long long writebacks)
+{
+    printf("L%d hits:%lld misses:%lld evictions:%lld writebacks:%lld\n",
+           level, hits, misses, evictions, writebacks);
+}
+
+/*
+ * printTrafficSummary - Summarize the traffic between one level of a
+ *     simulation and the next level down (memory below the last level).
+ */
+void printTrafficSummary(int level, long long dirty_evictions,
+                         long long bytes_read, long long bytes_written)
+{
+    printf("L%d dirty_evictions:%lld bytes_read:%lld bytes_written:%lld\n",
+           level, dirty_evictions, bytes_read, bytes_written);
+}
+
 /* 
  * initMatrix - Initialize the given matrix 
  */
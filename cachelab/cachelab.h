@@ -20,9 +20,23 @@ typedef struct trans_func{
  * printSummary - This function provides a standard way for your cache
  * simulator * to display its final hit and miss statistics
  */ 
-void printSummary(int hits,  /* number of  hits */
-				  int misses, /* number of misses */
-				  int evictions); /* number of evictions */
+void printSummary(long long hits,  /* number of  hits */
+				  long long misses, /* number of misses */
+				  long long evictions); /* number of evictions */
+
+/*
+ * printLevelSummary - Display the statistics of one level of a
+ * multi-level cache simulation (level 1 is closest to the CPU)
+ */
+void printLevelSummary(int level, long long hits, long long misses,
+                       long long evictions, long long writebacks);
+
+/*
+ * printTrafficSummary - Display one level's dirty evictions and the bytes
+ * it read from and wrote to the level below it
+ */
+void printTrafficSummary(int level, long long dirty_evictions,
+                         long long bytes_read, long long bytes_written);
 
 /* Fill the matrix with data */
 void initMatrix(int M, int N, int A[N][M], int B[M][N]);
@@ -1,50 +1,75 @@
+#define _DEFAULT_SOURCE
+
+#include <ctype.h>
 #include <getopt.h>
 #include <stdbool.h>
-#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <unistd.h>
+#include <string.h>
+#include <time.h>
 
+#include "cache.h"
 #include "cachelab.h"
-
-typedef struct line {
-    bool valid;
-    size_t tag;
-    size_t lru;
-} Line;
-
-typedef struct set {
-    Line* lines;
-} Set;
-
-typedef struct cache_config {
-    size_t set_bits;
-    size_t asso;
-    size_t block_bits;
-    bool verbose;
-} Cache_config;
-
-typedef struct cache {
-    Set* sets;
-    Cache_config config;
-    int hits;
-    int misses;
-    int evictions;
-} Cache;
-
-static void access_cache(size_t addr, Cache* cache);
-static void update_cache(char op, size_t addr, Cache* cache);
+#include "stackdist.h"
+#include "tracefile.h"
+
+static bool parse_level(const char* spec, Cache_config* config);
+static int read_config(const char* filename, Cache_config* configs,
+                       int count);
+
+static void usage(FILE* out, const char* prog) {
+    fprintf(out, "Usage: %s [-hvTwam] -s <s> -E <E> -b <b> -t <tracefile>\n",
+            prog);
+    fprintf(out, "       %s [-hvTwam] [-s <s> -E <E> -b <b> [-P <policy>]] "
+            "[-L <s:E:b[:opts]>]... [-C <file>] -t <tracefile>\n", prog);
+    fprintf(out, "Cache levels are listed from L1 down. opts is a "
+            "colon-separated list of\n"
+            "inclusive|exclusive|nine (w.r.t. the levels above, default "
+            "nine), wb|wt\n"
+            "(default wb), wa|nwa (default wa) and a replacement policy: "
+            "lru (default),\n"
+            "fifo, random, plru, srrip, brrip or opt (L1 only). A -C file "
+            "holds one level\nper line.\n"
+            "-j <n> simulates the sets on n threads when there is a single "
+            "wb/wa level, -v\nis off and the policy is lru, fifo, plru or "
+            "srrip.\n"
+            "-S s=<lo>-<hi>,E=<lo>-<hi>,b=<lo>-<hi> prints LRU results for "
+            "every geometry\nin the ranges from one stack-distance pass "
+            "per (b, s).\n"
+            "-w reports each level's dirty evictions and bytes read from "
+            "and written to\nthe level below (memory for the last "
+            "level).\n"
+            "-a splits accesses that cross L1 block boundaries into one "
+            "access per block\nand reports how many did.\n"
+            "-m sorts L1's misses into compulsory, capacity and conflict "
+            "misses.\n");
+}
 
 int main(int argc, char* argv[]) {
     int opt;
     bool help = false;
     bool verbose = false;
+    bool timing = false;
+    bool traffic = false;
+    bool split = false;
+    bool classify = false;
     int set_bits = 0;
     int asso = 0;
     int block_bits = 0;
+    const Policy* policy = find_policy("lru");
+    int threads = 1;
+    bool sweeping = false;
+    Sweep sweep;
     char* filename = NULL;
+    Cache_config configs[MAX_LEVELS];
+    int level_count = 0;
+    bool extra_levels = false;
 
-    while ((opt = getopt(argc, argv, "hvs:E:b:t:")) != -1) {
+    /* Levels given with -L and -C go below the -s/-E/-b level */
+    Cache_config* lower = configs + 1;
+    int lower_count = 0;
+
+    while ((opt = getopt(argc, argv, "hvTwams:E:b:t:P:j:S:L:C:")) != -1) {
         switch (opt) {
             case 'h':
                 help = true;
@@ -52,6 +77,18 @@ int main(int argc, char* argv[]) {
             case 'v':
                 verbose = true;
                 break;
+            case 'T':
+                timing = true;
+                break;
+            case 'w':
+                traffic = true;
+                break;
+            case 'a':
+                split = true;
+                break;
+            case 'm':
+                classify = true;
+                break;
             case 's':
                 set_bits = atoi(optarg);
                 break;
@@ -64,147 +101,276 @@ int main(int argc, char* argv[]) {
             case 't':
                 filename = optarg;
                 break;
+            case 'P':
+                if (!(policy = find_policy(optarg))) {
+                    fprintf(stderr, "%s: unknown policy: %s\n", argv[0],
+                            optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'j':
+                threads = atoi(optarg);
+                if (threads < 1 || threads > MAX_THREADS) {
+                    fprintf(stderr, "%s: -j takes 1 to %d threads\n",
+                            argv[0], MAX_THREADS);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'S':
+                if (!parse_sweep(optarg, &sweep)) {
+                    fprintf(stderr, "%s: bad sweep: %s\n", argv[0], optarg);
+                    exit(EXIT_FAILURE);
+                }
+                sweeping = true;
+                break;
+            case 'L':
+                if (lower_count == MAX_LEVELS - 1 ||
+                    !parse_level(optarg, &lower[lower_count])) {
+                    fprintf(stderr, "%s: bad or too many levels: -L %s\n",
+                            argv[0], optarg);
+                    exit(EXIT_FAILURE);
+                }
+                ++lower_count;
+                extra_levels = true;
+                break;
+            case 'C':
+                lower_count += read_config(optarg, &lower[lower_count],
+                                           MAX_LEVELS - 1 - lower_count);
+                extra_levels = true;
+                break;
             default:
-                fprintf(stderr, "Usage: %s [-t nsecs] [-n] name\n", argv[0]);
+                usage(stderr, argv[0]);
                 exit(EXIT_FAILURE);
         }
     }
 
     if (help) {
-        fprintf(stdout, "Usage: %s [-hv] -s <s> -E <E> -b <b> -t <tracefile>\n",
-                argv[0]);
+        usage(stdout, argv[0]);
         return 0;
     }
 
-    bool missing_or_bad = set_bits <= 0 || asso <= 0 || block_bits <= 0 ||
-                          filename == NULL || *filename == '\0';
+    if (sweeping && filename && *filename) {
+        run_sweep(filename, &sweep, split, stdout);
+        return 0;
+    }
+
+    bool l1_given = set_bits || asso || block_bits;
+    bool missing_or_bad = filename == NULL || *filename == '\0' ||
+                          (!l1_given && lower_count == 0) ||
+                          (l1_given && (set_bits <= 0 || asso <= 0 ||
+                                        block_bits <= 0));
 
     if (missing_or_bad) {
-        fprintf(stderr, "Usage: %s [-hv] -s <s> -E <E> -b <b> -t <tracefile>\n",
-                argv[0]);
+        usage(stderr, argv[0]);
         exit(EXIT_FAILURE);
     }
 
-    Cache_config config = {
-        .set_bits = set_bits,
-        .asso = asso,
-        .block_bits = block_bits,
-        .verbose = verbose
-    };
-
-    size_t set_count = 1u << set_bits;
-    size_t line_count = (size_t)asso;
+    if (l1_given) {
+        configs[0] = (Cache_config){
+            .set_bits = set_bits,
+            .asso = asso,
+            .block_bits = block_bits,
+            .inclusion = NINE,
+            .write_back = true,
+            .write_allocate = true,
+            .policy = policy
+        };
+        level_count = 1 + lower_count;
+    } else {
+        memmove(configs, lower, lower_count * sizeof(*configs));
+        level_count = lower_count;
+    }
 
-    Set* all_sets = calloc(set_count, sizeof(*all_sets));
-    Line* all_lines = calloc(set_count * line_count, sizeof *all_lines);
+    for (int i = 0; i < level_count; ++i) {
+        const char* name = configs[i].policy->name;
+        bool pow2 = (configs[i].asso & (configs[i].asso - 1)) == 0;
+        if (strcmp(name, "plru") == 0 && !pow2) {
+            fprintf(stderr, "%s: plru needs a power-of-two E\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+        if (strcmp(name, "opt") == 0 && i > 0) {
+            fprintf(stderr, "%s: opt needs to be used on L1\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
 
-    for (size_t s = 0; s < set_count; ++s) {
-        all_sets[s].lines = all_lines + s * line_count;
+    Cache levels[MAX_LEVELS];
+    for (int i = 0; i < level_count; ++i) {
+        configs[i].verbose = verbose;
+        init_cache(&levels[i], &configs[i]);
+    }
+    Hierarchy hierarchy = {.levels = levels, .count = level_count,
+                           .split = split};
+    Classifier classes;
+    if (classify) {
+        init_classifier(&classes, &configs[0]);
+        hierarchy.classes = &classes;
     }
 
-    Cache cache = {
-        .sets = all_sets,
-        .config = config,
-        .hits = 0,
-        .misses = 0,
-        .evictions = 0
-    };
+    const char* match_name = select_match();
 
-    FILE* fp = fopen(filename, "r");
-    if (!fp) {
-        perror("fopen");
-        exit(EXIT_FAILURE);
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    /* The rings carry no access sizes, which only write-through and
+       no-write-allocate stores need */
+    if (threads > 1 && level_count == 1 && !verbose && !classify &&
+        configs[0].policy->per_set && configs[0].write_back &&
+        configs[0].write_allocate) {
+        simulate_sharded(filename, &hierarchy, threads);
+    } else {
+        simulate_trace(filename, &hierarchy);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (timing) {
+        double secs = (end.tv_sec - start.tv_sec) +
+                      (end.tv_nsec - start.tv_nsec) / 1e9;
+        double accesses = (double)levels[0].hits + levels[0].misses;
+        fprintf(stderr, "%.0f accesses in %.6f s: %.2f M accesses/s "
+                "(%s tag match)\n", accesses, secs, accesses / secs / 1e6,
+                levels[0].config.asso > SIMD_MAX_ASSO ? "hashed"
+                                                      : match_name);
     }
 
-    char line[256];
-    while (fgets(line, sizeof line, fp) != NULL) {
-        if (line[0] == 'I') {
-            continue;
+    if (extra_levels) {
+        for (int i = 0; i < level_count; ++i) {
+            printLevelSummary(i + 1, levels[i].hits, levels[i].misses,
+                              levels[i].evictions, levels[i].writebacks);
         }
-
-        char op = line[1];
-
-        size_t addr = 0;
-        int size = 0;
-
-        sscanf(line + 3, "%zx,%d", &addr, &size);
-
-        update_cache(op, addr, &cache);
     }
+    if (traffic) {
+        for (int i = 0; i < level_count; ++i) {
+            printTrafficSummary(i + 1, levels[i].writebacks,
+                                levels[i].bytes_read,
+                                levels[i].bytes_written);
+        }
+    }
+    if (split) {
+        printf("straddles:%lld\n", hierarchy.straddles);
+    }
+    if (classify) {
+        printf("compulsory:%lld capacity:%lld conflict:%lld\n",
+               classes.compulsory, classes.capacity, classes.conflict);
+        free_classifier(&classes);
+    }
+    printSummary(levels[0].hits, levels[0].misses, levels[0].evictions);
 
-    fclose(fp);
-
-    free(all_lines);
-    free(all_sets);
-
-    printSummary(cache.hits, cache.misses, cache.evictions);
+    for (int i = 0; i < level_count; ++i) {
+        free_cache(&levels[i]);
+    }
 
     return 0;
 }
 
-static void access_cache(size_t addr, Cache* cache) {
-    static size_t tick = 0;
+/*
+ * parse_level - Parse a level spec "s:E:b[:opt]..." where each opt is one
+ * of inclusive, exclusive, nine, wb, wt, wa, nwa or a policy name.
+ * Returns false if the spec is malformed.
+ */
+static bool parse_level(const char* spec, Cache_config* config) {
+    char buf[128];
+    char* rest;
+    long fields[3];
+
+    if (strlen(spec) >= sizeof(buf)) {
+        return false;
+    }
+    strcpy(buf, spec);
+
+    char* token = strtok_r(buf, ":", &rest);
+    for (int i = 0; i < 3; ++i) {
+        char* end;
+        if (!token) {
+            return false;
+        }
+        fields[i] = strtol(token, &end, 10);
+        if (*end != '\0' || fields[i] < 0 || fields[i] > 1 << 16) {
+            return false;
+        }
+        token = strtok_r(NULL, ":", &rest);
+    }
+    if (fields[0] > 30 || fields[1] < 1 || fields[2] < 1 ||
+        fields[0] + fields[2] > 62) {
+        return false;
+    }
 
-    size_t set_bits = cache->config.set_bits;
-    size_t asso = cache->config.asso;
-    size_t block_bits = cache->config.block_bits;
+    *config = (Cache_config){
+        .set_bits = fields[0],
+        .asso = fields[1],
+        .block_bits = fields[2],
+        .inclusion = NINE,
+        .write_back = true,
+        .write_allocate = true,
+        .policy = find_policy("lru")
+    };
 
-    size_t set_index = (addr >> block_bits) & ((1u << set_bits) - 1);
-    size_t tag = addr >> (block_bits + set_bits);
+    for (; token; token = strtok_r(NULL, ":", &rest)) {
+        if (strcmp(token, "inclusive") == 0) {
+            config->inclusion = INCLUSIVE;
+        } else if (strcmp(token, "exclusive") == 0) {
+            config->inclusion = EXCLUSIVE;
+        } else if (strcmp(token, "nine") == 0) {
+            config->inclusion = NINE;
+        } else if (strcmp(token, "wb") == 0) {
+            config->write_back = true;
+        } else if (strcmp(token, "wt") == 0) {
+            config->write_back = false;
+        } else if (strcmp(token, "wa") == 0) {
+            config->write_allocate = true;
+        } else if (strcmp(token, "nwa") == 0) {
+            config->write_allocate = false;
+        } else if (find_policy(token)) {
+            config->policy = find_policy(token);
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
 
-    Set* curr_set = &cache->sets[set_index];
+/*
+ * read_config - Read up to count level specs from filename, one per line.
+ * Blank lines and text after '#' are ignored. Exits on errors; returns
+ * the number of levels read.
+ */
+static int read_config(const char* filename, Cache_config* configs,
+                       int count) {
+    FILE* fp = fopen(filename, "r");
+    char line[256];
+    int n = 0;
+    int lineno = 0;
 
-    int hit_index = -1;
-    int empty_index = -1;
-    int victim_index = 0;
-    size_t oldest = curr_set->lines[0].lru;
+    if (!fp) {
+        perror(filename);
+        exit(EXIT_FAILURE);
+    }
 
-    for (int i = 0; i < asso; ++i) {
-        Line* line = &curr_set->lines[i];
-        if (line->valid && line->tag == tag) {
-            hit_index = i;
-            break;
+    while (fgets(line, sizeof(line), fp)) {
+        ++lineno;
+        char* p = line;
+        char* comment = strchr(p, '#');
+        if (comment) {
+            *comment = '\0';
         }
-        if (!line->valid && empty_index == -1) {
-            empty_index = i;
+        while (isspace((unsigned char)*p)) {
+            ++p;
         }
-        if (line->valid && line->lru < oldest) {
-            victim_index = i;
-            oldest = line->lru;
+        char* end = p + strlen(p);
+        while (end > p && isspace((unsigned char)end[-1])) {
+            *--end = '\0';
+        }
+        if (*p == '\0') {
+            continue;
         }
-    }
 
-    if (hit_index != -1) {
-        ++cache->hits;
-        curr_set->lines[hit_index].lru = tick;
-    } else if (empty_index != -1) {
-        ++cache->misses;
-        curr_set->lines[empty_index].valid = true;
-        curr_set->lines[empty_index].tag = tag;
-        curr_set->lines[empty_index].lru = tick;
-    } else {
-        ++cache->misses;
-        ++cache->evictions;
-        curr_set->lines[victim_index].tag = tag;
-        curr_set->lines[victim_index].lru = tick;
+        if (n == count || !parse_level(p, &configs[n])) {
+            fprintf(stderr, "%s:%d: bad or too many levels: %s\n", filename,
+                    lineno, p);
+            exit(EXIT_FAILURE);
+        }
+        ++n;
     }
 
-    ++tick;
+    fclose(fp);
+    return n;
 }
-
-static void update_cache(char op, size_t addr, Cache* cache) {
-    switch (op) {
-        case 'L':
-            access_cache(addr, cache);
-            break;
-
-        case 'S':
-            access_cache(addr, cache);
-            break;
-
-        case 'M':
-            access_cache(addr, cache);
-            access_cache(addr, cache);
-            break;
-    }
-}
\ No newline at end of file
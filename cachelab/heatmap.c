@@ -0,0 +1,666 @@
+/*
+ * heatmap.c - Where a transpose's misses happen: per cache set, per
+ *     matrix row and set, and per tile
+ *
+ *     linux> ./test-trans -t -M 64 -N 64
+ *     linux> ./heatmap -s 5 -E 1 -b 5 -M 64 -N 64 -t trace.f0 -f csv,svg
+ *
+ * The trace (text or binary, such as the trace.f<n> of test-trans -t)
+ * is simulated on one level of csim's engine. Each access is charged to
+ * the row of A (int A[N][M]) or B (int B[M][N]) it touches and to its
+ * set, which is bits b..b+s of the address as in csim. A miss on a
+ * block that was cached before and evicted counts as a conflict here,
+ * and every eviction records which matrix row pushed out which: the
+ * collisions that make blocking schemes fail.
+ *
+ * A starts at the lowest address in the trace and B at the lowest one
+ * at least M*N ints further on, unless -A or -B gives them. Tiles are
+ * -w x -w squares of A; an access to B[j][i] belongs to the tile of
+ * A[i][j]. Output goes to <prefix>-<table>.<format> (prefix -o,
+ * default "heatmap"):
+ *     csv  sets, rows (matrix, row, set), tiles and collisions tables
+ *     ppm  sets, rows, rows-conflicts and tiles images, one cell per
+ *          value, white for none to dark red for the most
+ *     svg  the same images, each cell titled with what it counts
+ */
+#define _DEFAULT_SOURCE
+
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cache.h"
+#include "tracefile.h"
+
+#define BATCH_SIZE 4096
+
+/* pixels per cell in the images */
+#define CELL_PX 8
+
+typedef struct layout {
+    int M, N;
+    size_t a;   /* &A[0][0] */
+    size_t b;   /* &B[0][0] */
+} Layout;
+
+/* Per set counts */
+typedef struct set_count {
+    long accesses;
+    long misses;
+    long conflicts;
+    long evictions;
+} Set_count;
+
+/* One (set, incoming row, evicted row) triple of the collision table */
+typedef struct collision {
+    size_t set;
+    int row;        /* global row: see row_of */
+    int victim;
+    long count;
+} Collision;
+
+/* An open-addressing hash table of size_t keys, 0 meaning empty */
+typedef struct table {
+    size_t* keys;
+    long* values;
+    size_t mask;
+    size_t used;
+} Table;
+
+typedef struct heatmap {
+    Layout layout;
+    int s, b;
+    int tile;
+    int tile_rows, tile_cols;
+    int rows;               /* N rows of A, then M of B, then "other" */
+    Set_count* sets;
+    long* row_misses;       /* rows x sets */
+    long* row_conflicts;
+    long* tile_a;           /* tile_rows x tile_cols */
+    long* tile_b;
+    Table seen;             /* blocks + 1 ever cached */
+    Table pairs;            /* collision key -> index + 1 in collisions */
+    Collision* collisions;
+    size_t collision_count;
+    size_t collision_capacity;
+} Heatmap;
+
+static void* checked_calloc(size_t count, size_t size) {
+    void* p = calloc(count ? count : 1, size);
+    if (!p) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+static size_t hash_key(size_t key) {
+    return (size_t)((key * 0x9e3779b97f4a7c15ull) >> 17);
+}
+
+static void table_init(Table* t, size_t slots) {
+    t->keys = checked_calloc(slots, sizeof(*t->keys));
+    t->values = checked_calloc(slots, sizeof(*t->values));
+    t->mask = slots - 1;
+    t->used = 0;
+}
+
+static void table_free(Table* t) {
+    free(t->keys);
+    free(t->values);
+}
+
+/* table_slot - The value of key, added with value 0 if absent */
+static long* table_slot(Table* t, size_t key) {
+    if (2 * (t->used + 1) > t->mask + 1) {
+        Table bigger;
+        table_init(&bigger, 2 * (t->mask + 1));
+        for (size_t i = 0; i <= t->mask; ++i) {
+            if (t->keys[i]) {
+                *table_slot(&bigger, t->keys[i]) = t->values[i];
+            }
+        }
+        table_free(t);
+        *t = bigger;
+    }
+
+    size_t i = hash_key(key) & t->mask;
+    while (t->keys[i] && t->keys[i] != key) {
+        i = (i + 1) & t->mask;
+    }
+    if (!t->keys[i]) {
+        t->keys[i] = key;
+        ++t->used;
+    }
+    return &t->values[i];
+}
+
+/*
+ * row_of - The global row of addr: 0..N-1 for rows of A, N..N+M-1 for
+ * rows of B, N+M for anything else. Sets *i and *j to its indices in
+ * the matrix when it is in one.
+ */
+static int row_of(const Layout* l, size_t addr, int* i, int* j) {
+    size_t bytes = (size_t)l->M * l->N * sizeof(int);
+
+    if (addr - l->a < bytes) {
+        size_t k = (addr - l->a) / sizeof(int);
+        *i = (int)(k / l->M);
+        *j = (int)(k % l->M);
+        return *i;
+    }
+    if (addr - l->b < bytes) {
+        size_t k = (addr - l->b) / sizeof(int);
+        *i = (int)(k / l->N);
+        *j = (int)(k % l->N);
+        return l->N + *i;
+    }
+    return l->N + l->M;
+}
+
+static void row_name(const Layout* l, int row, char* name, size_t size) {
+    if (row < l->N) {
+        snprintf(name, size, "A,%d", row);
+    } else if (row < l->N + l->M) {
+        snprintf(name, size, "B,%d", row - l->N);
+    } else {
+        snprintf(name, size, "other,");
+    }
+}
+
+static void add_collision(Heatmap* h, size_t set, int row, int victim) {
+    size_t key = ((set * (h->rows + 1) + row) * (h->rows + 1) + victim) + 1;
+    long* slot = table_slot(&h->pairs, key);
+
+    if (!*slot) {
+        if (h->collision_count == h->collision_capacity) {
+            h->collision_capacity = h->collision_capacity
+                                        ? 2 * h->collision_capacity
+                                        : 256;
+            h->collisions = realloc(h->collisions, h->collision_capacity *
+                                                       sizeof(Collision));
+            if (!h->collisions) {
+                perror("realloc");
+                exit(EXIT_FAILURE);
+            }
+        }
+        h->collisions[h->collision_count] =
+            (Collision){set, row, victim, 0};
+        *slot = (long)++h->collision_count;
+    }
+    ++h->collisions[*slot - 1].count;
+}
+
+/*
+ * access_block - Simulate one load or store and charge its outcome. The
+ * set's tags are saved first so that an eviction can be traced back to
+ * the block it threw out.
+ */
+static void access_block(Heatmap* h, Hierarchy* hier, size_t addr,
+                         int size, char op, size_t* saved_tags,
+                         uint64_t* saved_valid) {
+    Cache* cache = &hier->levels[0];
+    size_t set_index = (addr >> h->b) & (((size_t)1 << h->s) - 1);
+    size_t tag = addr >> (h->b + h->s);
+    Set* set = &cache->sets[set_index];
+    size_t asso = cache->config.asso;
+    size_t words = (asso + 63) / 64;
+    long long misses = cache->misses;
+    long long evictions = cache->evictions;
+    Access access = {.addr = addr, .size = size, .op = op};
+    int i, j;
+
+    memcpy(saved_tags, set->tags, asso * sizeof(*saved_tags));
+    memcpy(saved_valid, set->valid, words * sizeof(*saved_valid));
+    update_cache(&access, hier);
+
+    int row = row_of(&h->layout, addr, &i, &j);
+    Set_count* count = &h->sets[set_index];
+    ++count->accesses;
+    if (cache->misses == misses) {
+        return;
+    }
+
+    long* seen = table_slot(&h->seen, (addr >> h->b) + 1);
+    bool conflict = *seen;
+    *seen = 1;
+
+    ++count->misses;
+    count->conflicts += conflict;
+    h->row_misses[(size_t)row * ((size_t)1 << h->s) + set_index]++;
+    h->row_conflicts[(size_t)row * ((size_t)1 << h->s) + set_index] +=
+        conflict;
+    if (row < h->layout.N) {
+        h->tile_a[(i / h->tile) * h->tile_cols + j / h->tile]++;
+    } else if (row < h->layout.N + h->layout.M) {
+        /* B[i][j] is the image of A[j][i] */
+        h->tile_b[(j / h->tile) * h->tile_cols + i / h->tile]++;
+    }
+
+    if (cache->evictions == evictions) {
+        return;
+    }
+    ++count->evictions;
+    for (size_t way = 0; way < asso; ++way) {
+        bool was_valid = (saved_valid[way / 64] >> (way % 64)) & 1;
+        if (was_valid && set->tags[way] == tag && saved_tags[way] != tag) {
+            size_t victim = (saved_tags[way] << (h->b + h->s)) |
+                            (set_index << h->b);
+            add_collision(h, set_index, row,
+                          row_of(&h->layout, victim, &i, &j));
+            break;
+        }
+    }
+}
+
+/* find_layout - Fill in the bases -A and -B did not give */
+static void find_layout(Layout* l, const char* filename, bool have_a,
+                        bool have_b) {
+    size_t bytes = (size_t)l->M * l->N * sizeof(int);
+    Access batch[BATCH_SIZE];
+    size_t count;
+
+    for (int pass = 0; pass < 2; ++pass) {
+        bool want = pass == 0 ? !have_a : !have_b;
+        size_t lowest = SIZE_MAX;
+        if (!want) {
+            continue;
+        }
+        Trace_reader* reader = trace_open(filename);
+        while ((count = trace_read(reader, batch, BATCH_SIZE)) > 0) {
+            for (size_t k = 0; k < count; ++k) {
+                size_t addr = batch[k].addr;
+                if (batch[k].op != 'I' && addr < lowest &&
+                    (pass == 0 || addr >= l->a + bytes)) {
+                    lowest = addr;
+                }
+            }
+        }
+        trace_close(reader);
+        if (lowest == SIZE_MAX) {
+            fprintf(stderr, "heatmap: cannot place %s in the trace\n",
+                    pass == 0 ? "A" : "B");
+            exit(EXIT_FAILURE);
+        }
+        *(pass == 0 ? &l->a : &l->b) = lowest;
+    }
+}
+
+static FILE* open_output(const char* prefix, const char* table,
+                         const char* format) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s-%s.%s", prefix, table, format);
+    FILE* fp = fopen(path, "w");
+    if (!fp) {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+    return fp;
+}
+
+static void write_csv(const Heatmap* h, const char* prefix) {
+    size_t set_count = (size_t)1 << h->s;
+    char name[32];
+    char victim[32];
+    FILE* fp;
+
+    fp = open_output(prefix, "sets", "csv");
+    fprintf(fp, "set,accesses,hits,misses,conflicts,evictions\n");
+    for (size_t s = 0; s < set_count; ++s) {
+        const Set_count* c = &h->sets[s];
+        fprintf(fp, "%zu,%ld,%ld,%ld,%ld,%ld\n", s, c->accesses,
+                c->accesses - c->misses, c->misses, c->conflicts,
+                c->evictions);
+    }
+    fclose(fp);
+
+    fp = open_output(prefix, "rows", "csv");
+    fprintf(fp, "matrix,row,set,misses,conflicts\n");
+    for (int r = 0; r <= h->layout.N + h->layout.M; ++r) {
+        row_name(&h->layout, r, name, sizeof(name));
+        for (size_t s = 0; s < set_count; ++s) {
+            long misses = h->row_misses[(size_t)r * set_count + s];
+            if (misses) {
+                fprintf(fp, "%s,%zu,%ld,%ld\n", name, s, misses,
+                        h->row_conflicts[(size_t)r * set_count + s]);
+            }
+        }
+    }
+    fclose(fp);
+
+    fp = open_output(prefix, "tiles", "csv");
+    fprintf(fp, "tile_row,tile_col,first_row,first_col,a_misses,b_misses,"
+            "misses\n");
+    for (int r = 0; r < h->tile_rows; ++r) {
+        for (int c = 0; c < h->tile_cols; ++c) {
+            long a = h->tile_a[r * h->tile_cols + c];
+            long b = h->tile_b[r * h->tile_cols + c];
+            fprintf(fp, "%d,%d,%d,%d,%ld,%ld,%ld\n", r, c, r * h->tile,
+                    c * h->tile, a, b, a + b);
+        }
+    }
+    fclose(fp);
+
+    fp = open_output(prefix, "collisions", "csv");
+    fprintf(fp, "set,matrix,row,evicted_matrix,evicted_row,count\n");
+    for (size_t k = 0; k < h->collision_count; ++k) {
+        const Collision* c = &h->collisions[k];
+        row_name(&h->layout, c->row, name, sizeof(name));
+        row_name(&h->layout, c->victim, victim, sizeof(victim));
+        fprintf(fp, "%zu,%s,%s,%ld\n", c->set, name, victim, c->count);
+    }
+    fclose(fp);
+}
+
+/* A rows x cols grid of counts to draw, with how to label its cells */
+typedef struct grid {
+    const char* table;
+    const char* what;       /* what a cell counts */
+    int rows, cols;
+    const long* values;
+    const Heatmap* heatmap;
+    void (*label)(const struct grid* g, int r, int c, char* s, size_t n);
+} Grid;
+
+static void label_set(const Grid* g, int r, int c, char* s, size_t n) {
+    snprintf(s, n, "set %d", c);
+}
+
+static void label_row(const Grid* g, int r, int c, char* s, size_t n) {
+    char name[32];
+    row_name(&g->heatmap->layout, r, name, sizeof(name));
+    *strchr(name, ',') = ' ';
+    snprintf(s, n, "%s, set %d", name, c);
+}
+
+static void label_tile(const Grid* g, int r, int c, char* s, size_t n) {
+    int tile = g->heatmap->tile;
+    snprintf(s, n, "tile A[%d..][%d..]", r * tile, c * tile);
+}
+
+/* shade - White for 0 through yellow and red to dark red for max */
+static void shade(long value, long max, unsigned char rgb[3]) {
+    double t = max > 0 ? (double)value / max : 0;
+
+    if (value == 0) {
+        rgb[0] = rgb[1] = rgb[2] = 255;
+    } else if (t < 0.5) {
+        rgb[0] = 255;
+        rgb[1] = (unsigned char)(230 - 230 * 2 * t);
+        rgb[2] = (unsigned char)(160 - 160 * 2 * t);
+    } else {
+        rgb[0] = (unsigned char)(255 - 127 * 2 * (t - 0.5));
+        rgb[1] = 0;
+        rgb[2] = 0;
+    }
+}
+
+static long grid_max(const Grid* g) {
+    long max = 0;
+    for (size_t k = 0; k < (size_t)g->rows * g->cols; ++k) {
+        max = g->values[k] > max ? g->values[k] : max;
+    }
+    return max;
+}
+
+static void write_ppm(const Grid* g, const char* prefix) {
+    FILE* fp = open_output(prefix, g->table, "ppm");
+    long max = grid_max(g);
+    unsigned char rgb[3];
+
+    fprintf(fp, "P6\n%d %d\n255\n", g->cols * CELL_PX, g->rows * CELL_PX);
+    for (int y = 0; y < g->rows * CELL_PX; ++y) {
+        for (int x = 0; x < g->cols * CELL_PX; ++x) {
+            shade(g->values[(size_t)(y / CELL_PX) * g->cols + x / CELL_PX],
+                  max, rgb);
+            fwrite(rgb, 1, 3, fp);
+        }
+    }
+    fclose(fp);
+}
+
+static void write_svg(const Grid* g, const char* prefix) {
+    FILE* fp = open_output(prefix, g->table, "svg");
+    long max = grid_max(g);
+    unsigned char rgb[3];
+    char label[64];
+
+    fprintf(fp, "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%d\" "
+            "height=\"%d\">\n", g->cols * CELL_PX, g->rows * CELL_PX + 20);
+    fprintf(fp, "<text x=\"2\" y=\"14\" font-size=\"12\">%s: %s "
+            "(max %ld)</text>\n", g->table, g->what, max);
+    fprintf(fp, "<rect y=\"20\" width=\"%d\" height=\"%d\" "
+            "fill=\"white\"/>\n", g->cols * CELL_PX, g->rows * CELL_PX);
+    for (int r = 0; r < g->rows; ++r) {
+        for (int c = 0; c < g->cols; ++c) {
+            long value = g->values[(size_t)r * g->cols + c];
+            if (!value) {
+                continue;
+            }
+            shade(value, max, rgb);
+            g->label(g, r, c, label, sizeof(label));
+            fprintf(fp, "<rect x=\"%d\" y=\"%d\" width=\"%d\" height=\"%d\" "
+                    "fill=\"#%02x%02x%02x\"><title>%s: %ld %s</title>"
+                    "</rect>\n", c * CELL_PX, 20 + r * CELL_PX, CELL_PX,
+                    CELL_PX, rgb[0], rgb[1], rgb[2], label, value, g->what);
+        }
+    }
+    fprintf(fp, "</svg>\n");
+    fclose(fp);
+}
+
+/* write_images - The sets, rows, rows-conflicts and tiles grids */
+static void write_images(const Heatmap* h, const char* prefix, bool svg) {
+    size_t set_count = (size_t)1 << h->s;
+    long* sets = checked_calloc(2 * set_count, sizeof(*sets));
+    long* tiles = checked_calloc((size_t)h->tile_rows * h->tile_cols,
+                                 sizeof(*tiles));
+
+    /* Row 0 misses, row 1 conflicts */
+    for (size_t s = 0; s < set_count; ++s) {
+        sets[s] = h->sets[s].misses;
+        sets[set_count + s] = h->sets[s].conflicts;
+    }
+    for (size_t k = 0; k < (size_t)h->tile_rows * h->tile_cols; ++k) {
+        tiles[k] = h->tile_a[k] + h->tile_b[k];
+    }
+
+    Grid grids[] = {
+        {"sets", "misses (top) and conflicts (bottom)", 2, (int)set_count,
+         sets, h, label_set},
+        {"rows", "misses", h->rows, (int)set_count, h->row_misses, h,
+         label_row},
+        {"rows-conflicts", "conflicts", h->rows, (int)set_count,
+         h->row_conflicts, h, label_row},
+        {"tiles", "misses", h->tile_rows, h->tile_cols, tiles, h,
+         label_tile},
+    };
+    for (size_t k = 0; k < sizeof(grids) / sizeof(grids[0]); ++k) {
+        if (svg) {
+            write_svg(&grids[k], prefix);
+        } else {
+            write_ppm(&grids[k], prefix);
+        }
+    }
+
+    free(tiles);
+    free(sets);
+}
+
+static void usage(FILE* out, const char* prog) {
+    fprintf(out, "Usage: %s -s <s> -E <E> -b <b> -M <M> -N <N> -t <trace> "
+            "[-P <policy>]\n"
+            "       [-A <addr> -B <addr>] [-w <tile>] [-f <formats>] "
+            "[-o <prefix>]\n", prog);
+    fprintf(out, "Maps the misses of a transpose of int A[N][M] into "
+            "int B[M][N] per cache set,\nper matrix row and set, and per "
+            "tile.\n"
+            "  -A, -B  Addresses (hex) of A[0][0] and B[0][0] "
+            "(default: found in the trace)\n"
+            "  -w      Tile size (default 8)\n"
+            "  -f      Comma-separated formats: csv, ppm, svg "
+            "(default csv)\n"
+            "  -o      Output file prefix (default heatmap)\n");
+}
+
+int main(int argc, char* argv[]) {
+    int s = -1, E = 0, b = 0;
+    const Policy* policy = find_policy("lru");
+    const char* filename = NULL;
+    const char* formats = "csv";
+    const char* prefix = "heatmap";
+    Heatmap h = {.tile = 8};
+    bool have_a = false, have_b = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "hs:E:b:P:M:N:t:A:B:w:f:o:")) != -1) {
+        switch (opt) {
+            case 's':
+                s = atoi(optarg);
+                break;
+            case 'E':
+                E = atoi(optarg);
+                break;
+            case 'b':
+                b = atoi(optarg);
+                break;
+            case 'P':
+                policy = find_policy(optarg);
+                if (!policy || strcmp(policy->name, "opt") == 0) {
+                    fprintf(stderr, "%s: unknown or unsupported policy: "
+                            "%s\n", argv[0], optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'M':
+                h.layout.M = atoi(optarg);
+                break;
+            case 'N':
+                h.layout.N = atoi(optarg);
+                break;
+            case 't':
+                filename = optarg;
+                break;
+            case 'A':
+            case 'B':
+                *(opt == 'A' ? &h.layout.a : &h.layout.b) =
+                    (size_t)strtoull(optarg, NULL, 16);
+                *(opt == 'A' ? &have_a : &have_b) = true;
+                break;
+            case 'w':
+                h.tile = atoi(optarg);
+                break;
+            case 'f':
+                formats = optarg;
+                break;
+            case 'o':
+                prefix = optarg;
+                break;
+            case 'h':
+                usage(stdout, argv[0]);
+                return 0;
+            default:
+                usage(stderr, argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if (s < 0 || s > 20 || E < 1 || b < 1 || s + b > 62 || !filename ||
+        h.layout.M < 1 || h.layout.N < 1 || h.tile < 1) {
+        usage(stderr, argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (strcmp(policy->name, "plru") == 0 && (E & (E - 1)) != 0) {
+        fprintf(stderr, "%s: plru needs a power-of-two E\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    bool csv = strstr(formats, "csv") != NULL;
+    bool ppm = strstr(formats, "ppm") != NULL;
+    bool svg = strstr(formats, "svg") != NULL;
+    if (!csv && !ppm && !svg) {
+        fprintf(stderr, "%s: no known format in %s\n", argv[0], formats);
+        exit(EXIT_FAILURE);
+    }
+
+    find_layout(&h.layout, filename, have_a, have_b);
+
+    Cache_config config = {
+        .set_bits = s,
+        .asso = E,
+        .block_bits = b,
+        .inclusion = NINE,
+        .write_back = true,
+        .write_allocate = true,
+        .policy = policy
+    };
+    Cache cache;
+    init_cache(&cache, &config);
+    Hierarchy hier = {.levels = &cache, .count = 1};
+
+    size_t set_count = (size_t)1 << s;
+    h.s = s;
+    h.b = b;
+    h.rows = h.layout.N + h.layout.M + 1;
+    h.tile_rows = (h.layout.N + h.tile - 1) / h.tile;
+    h.tile_cols = (h.layout.M + h.tile - 1) / h.tile;
+    h.sets = checked_calloc(set_count, sizeof(*h.sets));
+    h.row_misses = checked_calloc((size_t)h.rows * set_count,
+                                  sizeof(*h.row_misses));
+    h.row_conflicts = checked_calloc((size_t)h.rows * set_count,
+                                     sizeof(*h.row_conflicts));
+    h.tile_a = checked_calloc((size_t)h.tile_rows * h.tile_cols,
+                              sizeof(*h.tile_a));
+    h.tile_b = checked_calloc((size_t)h.tile_rows * h.tile_cols,
+                              sizeof(*h.tile_b));
+    table_init(&h.seen, 1024);
+    table_init(&h.pairs, 1024);
+
+    size_t* saved_tags = checked_calloc(E, sizeof(*saved_tags));
+    uint64_t* saved_valid = checked_calloc((E + 63) / 64,
+                                           sizeof(*saved_valid));
+    Trace_reader* reader = trace_open(filename);
+    Access batch[BATCH_SIZE];
+    size_t count;
+    while ((count = trace_read(reader, batch, BATCH_SIZE)) > 0) {
+        for (size_t k = 0; k < count; ++k) {
+            const Access* a = &batch[k];
+            if (a->op == 'L' || a->op == 'M') {
+                access_block(&h, &hier, a->addr, a->size, 'L', saved_tags,
+                             saved_valid);
+            }
+            if (a->op == 'S' || a->op == 'M') {
+                access_block(&h, &hier, a->addr, a->size, 'S', saved_tags,
+                             saved_valid);
+            }
+        }
+    }
+    trace_close(reader);
+
+    printf("A at %zx, B at %zx\n", h.layout.a, h.layout.b);
+    printf("hits:%lld misses:%lld evictions:%lld\n", cache.hits, cache.misses,
+           cache.evictions);
+    if (csv) {
+        write_csv(&h, prefix);
+    }
+    if (ppm) {
+        write_images(&h, prefix, false);
+    }
+    if (svg) {
+        write_images(&h, prefix, true);
+    }
+
+    free(saved_valid);
+    free(saved_tags);
+    table_free(&h.pairs);
+    table_free(&h.seen);
+    free(h.collisions);
+    free(h.tile_b);
+    free(h.tile_a);
+    free(h.row_conflicts);
+    free(h.row_misses);
+    free(h.sets);
+    free_cache(&cache);
+    return 0;
+}
@@ -0,0 +1,75 @@
+/*
+ * libcsim.c - csim as a library: a handle around one level of cache.c
+ */
+#include "libcsim.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "cache.h"
+
+struct csim {
+    Cache cache;
+    Hierarchy hierarchy;
+};
+
+Csim* csim_create(int s, int E, int b, const char* policy) {
+    const Policy* p = find_policy(policy ? policy : "lru");
+
+    if (!p || strcmp(p->name, "opt") == 0 || s < 0 || s > 30 || E < 1 ||
+        E > 1 << 16 || b < 1 || s + b > 62) {
+        return NULL;
+    }
+    if (strcmp(p->name, "plru") == 0 && (E & (E - 1)) != 0) {
+        return NULL;
+    }
+
+    Csim* csim = malloc(sizeof(*csim));
+    if (!csim) {
+        return NULL;
+    }
+
+    Cache_config config = {
+        .set_bits = s,
+        .asso = E,
+        .block_bits = b,
+        .inclusion = NINE,
+        .write_back = true,
+        .write_allocate = true,
+        .policy = p
+    };
+    init_cache(&csim->cache, &config);
+    /* Charge unaligned vector accesses to every block they touch */
+    csim->hierarchy = (Hierarchy){.levels = &csim->cache, .count = 1,
+                                  .split = true};
+    return csim;
+}
+
+void csim_destroy(Csim* csim) {
+    if (csim) {
+        free_cache(&csim->cache);
+        free(csim);
+    }
+}
+
+void csim_access(Csim* csim, size_t addr, int size, char op) {
+    Access access = {.addr = addr, .size = size, .op = op};
+    update_cache(&access, &csim->hierarchy);
+}
+
+void csim_access_batch(Csim* csim, const Access* accesses, size_t count) {
+    simulate_batch(accesses, count, &csim->hierarchy);
+}
+
+void csim_stats(const Csim* csim, Csim_stats* stats) {
+    const Cache* cache = &csim->cache;
+
+    *stats = (Csim_stats){
+        .hits = cache->hits,
+        .misses = cache->misses,
+        .evictions = cache->evictions,
+        .writebacks = cache->writebacks,
+        .bytes_read = cache->bytes_read,
+        .bytes_written = cache->bytes_written
+    };
+}
@@ -0,0 +1,60 @@
+/*
+ * libcsim.h - csim as a library
+ *
+ * An opaque handle to one simulated cache level (write-back,
+ * write-allocate, memory below it), for tools that want to feed accesses
+ * to the simulator directly instead of writing a trace for csim. An
+ * access that crosses block boundaries counts once per block it
+ * touches, as under csim -a:
+ *
+ *     Csim* csim = csim_create(5, 1, 5, "lru");
+ *     csim_access(csim, addr, 4, 'L');
+ *     ...
+ *     Csim_stats stats;
+ *     csim_stats(csim, &stats);
+ *     csim_destroy(csim);
+ *
+ * Link with libcsim.a and -pthread.
+ */
+
+#ifndef CACHELAB_LIBCSIM_H
+#define CACHELAB_LIBCSIM_H
+
+#include <stddef.h>
+
+#include "tracefile.h"
+
+typedef struct csim Csim;
+
+typedef struct csim_stats {
+    long long hits;
+    long long misses;
+    long long evictions;
+    long long writebacks;       /* dirty evictions */
+    long long bytes_read;       /* from memory */
+    long long bytes_written;    /* to memory */
+} Csim_stats;
+
+/*
+ * csim_create - An empty cache of 2^s sets of E ways of 2^b bytes, with
+ * one of csim's replacement policies (NULL means lru). Returns NULL if
+ * the geometry is out of range or the policy unknown; opt, which needs
+ * the whole trace in advance, is not available here.
+ */
+Csim* csim_create(int s, int E, int b, const char* policy);
+
+void csim_destroy(Csim* csim);
+
+/*
+ * csim_access - Simulate a trace record: op is 'L', 'S' or 'M' (a load
+ * then a store); 'I' is ignored. As in csim, size only matters for
+ * traffic, not for which block is touched.
+ */
+void csim_access(Csim* csim, size_t addr, int size, char op);
+
+void csim_access_batch(Csim* csim, const Access* accesses, size_t count);
+
+/* csim_stats - The counts so far */
+void csim_stats(const Csim* csim, Csim_stats* stats);
+
+#endif /* CACHELAB_LIBCSIM_H */
@@ -0,0 +1,345 @@
+/*
+ * perf-trans.c - Misses of the registered transpose functions on the
+ *     real CPU next to the misses the lab's cache model predicts
+ *
+ *     linux> ./perf-trans
+ *     linux> ./perf-trans -M 64 -N 64 -r 1000
+ *
+ * Every function in trans.c is linked twice. The plain -O0 build that
+ * tracegen runs (trans-native.o, trans.o and transpose.o with their
+ * symbols renamed native_*) is run -r times under the perf_event
+ * counters for L1D load misses, LLC misses and CPU cycles; the counts
+ * printed are per run. Before each run, A and B are set up again and the
+ * caches are flushed by touching -F megabytes (default 64), so that like
+ * the model every run starts cold; -w keeps them warm instead. The copy
+ * in trans-traced.o is run once and simulated with libcsim on 2^s sets
+ * of E ways of 2^b bytes (default 5, 1, 5, the lab's 1KB direct-mapped
+ * cache). A and B are laid out as test-trans lays them out, so both
+ * copies see the addresses the driver scores.
+ *
+ * Without -M and -N the three matrices the driver grades are measured.
+ * Counters the kernel does not offer (no PMU, perf_event_paranoid too
+ * high, a container without perf_event_open) are printed as n/a.
+ */
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <getopt.h>
+#include <linux/perf_event.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "cachelab.h"
+#include "libcsim.h"
+#include "tracehook.h"
+
+/* Maximum array dimension, as in test-trans */
+#define MAXN 256
+
+/* trans.c twice: at -O0 with symbols renamed native_*, and traced */
+void native_registerFunctions();
+void registerFunctions();
+
+extern trans_func_t func_list[MAX_TRANS_FUNCS];
+extern int func_counter;
+
+/* The matrices, laid out like test-trans's */
+static struct {
+    int A[MAXN][MAXN];
+    int B[MAXN][MAXN];
+} matrices __attribute__((aligned(4096)));
+static int C[MAXN * MAXN];
+
+typedef struct counter {
+    const char* name;
+    uint32_t type;
+    uint64_t config;
+    int fd;
+} Counter;
+
+#define HW_CACHE_MISS(cache) \
+    ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | \
+     (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+static Counter counters[] = {
+    {"L1D misses", PERF_TYPE_HW_CACHE, HW_CACHE_MISS(PERF_COUNT_HW_CACHE_L1D),
+     -1},
+    {"LLC misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, -1},
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1},
+};
+
+#define COUNTER_COUNT (int)(sizeof(counters) / sizeof(counters[0]))
+
+/* The cache that is simulated */
+static int sim_s = 5, sim_E = 1, sim_b = 5;
+
+/* The buffer that is touched to flush the caches, or NULL with -w */
+static volatile char* flush;
+static size_t flush_bytes;
+
+/*
+ * open_counters - Open each counter on this thread, disabled; those the
+ *     kernel refuses keep fd -1 and are reported once on stderr
+ */
+static void open_counters(const char* prog) {
+    for (int c = 0; c < COUNTER_COUNT; ++c) {
+        struct perf_event_attr attr;
+
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = counters[c].type;
+        attr.config = counters[c].config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        counters[c].fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (counters[c].fd < 0) {
+            fprintf(stderr, "%s: no %s counter: %s\n", prog, counters[c].name,
+                    strerror(errno));
+        }
+    }
+}
+
+static void close_counters(void) {
+    for (int c = 0; c < COUNTER_COUNT; ++c) {
+        if (counters[c].fd >= 0) {
+            close(counters[c].fd);
+        }
+    }
+}
+
+static void flush_caches(void) {
+    if (flush) {
+        for (size_t k = 0; k < flush_bytes; k += 64) {
+            flush[k]++;
+        }
+    }
+}
+
+static void simulate_access(const Access* access, void* arg) {
+    csim_access(arg, access->addr, access->size, access->op);
+}
+
+/* validate - Whether B is the baseline transpose of A */
+static bool validate(int M, int N, int A[N][M], int B[M][N]) {
+    int (*expected)[N] = (int (*)[N])C;
+
+    correctTrans(M, N, A, expected);
+    for (int i = 0; i < M; ++i) {
+        for (int j = 0; j < N; ++j) {
+            if (B[i][j] != expected[i][j]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/* simulate - Misses of a traced function on a cold cache, or -1 if wrong */
+static long long simulate(const trans_func_t* f, int M, int N) {
+    int (*A)[M] = (int (*)[M])matrices.A;
+    int (*B)[N] = (int (*)[N])matrices.B;
+    Csim* csim = csim_create(sim_s, sim_E, sim_b, "lru");
+    Csim_stats stats;
+
+    initMatrix(M, N, A, B);
+    tracehook_start(simulate_access, csim);
+    f->func_ptr(M, N, A, B);
+    tracehook_stop();
+
+    csim_stats(csim, &stats);
+    csim_destroy(csim);
+    return validate(M, N, A, B) ? stats.misses : -1;
+}
+
+/*
+ * measure - Count runs runs of a native function, each from freshly set
+ *     up matrices; counts[c] is the total of counter c. Returns false if
+ *     the function's result is wrong.
+ */
+static bool measure(const trans_func_t* f, int M, int N, int runs,
+                    long long counts[COUNTER_COUNT]) {
+    int (*A)[M] = (int (*)[M])matrices.A;
+    int (*B)[N] = (int (*)[N])matrices.B;
+
+    memset(counts, 0, COUNTER_COUNT * sizeof(long long));
+    for (int r = 0; r < runs; ++r) {
+        initMatrix(M, N, A, B);
+        flush_caches();
+        for (int c = 0; c < COUNTER_COUNT; ++c) {
+            if (counters[c].fd >= 0) {
+                ioctl(counters[c].fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(counters[c].fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+        f->func_ptr(M, N, A, B);
+        for (int c = 0; c < COUNTER_COUNT; ++c) {
+            if (counters[c].fd >= 0) {
+                ioctl(counters[c].fd, PERF_EVENT_IOC_DISABLE, 0);
+            }
+        }
+        for (int c = 0; c < COUNTER_COUNT; ++c) {
+            uint64_t value;
+            if (counters[c].fd >= 0 &&
+                read(counters[c].fd, &value, sizeof(value)) == sizeof(value)) {
+                counts[c] += value;
+            }
+        }
+        if (!validate(M, N, A, B)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* compare - One table: the functions of one matrix shape */
+static void compare(const trans_func_t* native, const trans_func_t* traced,
+                    int count, int M, int N, int runs) {
+    printf("\n%d x %d (M=%d, N=%d), simulated on s=%d E=%d b=%d, "
+           "counted over %d %s runs\n", N, M, M, N, sim_s, sim_E, sim_b, runs,
+           flush ? "cold" : "warm");
+    printf("%-4s %10s", "func", "simulated");
+    for (int c = 0; c < COUNTER_COUNT; ++c) {
+        printf(" %12s", counters[c].name);
+    }
+    printf("  %s\n", "description");
+
+    for (int i = 0; i < count; ++i) {
+        long long counts[COUNTER_COUNT];
+        long long misses = simulate(&traced[i], M, N);
+        bool correct = measure(&native[i], M, N, runs, counts);
+
+        printf("%-4d ", i);
+        if (misses < 0) {
+            printf("%10s", "wrong");
+        } else {
+            printf("%10lld", misses);
+        }
+        for (int c = 0; c < COUNTER_COUNT; ++c) {
+            if (!correct) {
+                printf(" %12s", "wrong");
+            } else if (counters[c].fd < 0) {
+                printf(" %12s", "n/a");
+            } else {
+                printf(" %12.1f", (double)counts[c] / runs);
+            }
+        }
+        printf("  %s\n", native[i].description);
+        fflush(stdout);
+    }
+}
+
+static void usage(FILE* out, const char* prog) {
+    fprintf(out, "Usage: %s [-hw] [-M <M> -N <N>] [-s <s> -E <E> -b <b>] "
+            "[-r <runs>] [-F <MB>]\n", prog);
+    fprintf(out, "Counts the hardware cache misses and cycles of each "
+            "registered transpose\nfunction and prints them next to its "
+            "misses on a simulated cache of 2^s\nsets of E ways of 2^b "
+            "bytes (default 5, 1, 5). Without -M and -N, the\n32x32, "
+            "64x64 and 61x67 matrices are measured.\n"
+            "  -r  Counted runs per function, the mean is reported "
+            "(default 100)\n"
+            "  -F  Megabytes touched before each run to flush the caches "
+            "(default 64)\n"
+            "  -w  Do not flush the caches between runs\n");
+}
+
+int main(int argc, char* argv[]) {
+    static const int shapes[][2] = {{32, 32}, {64, 64}, {61, 67}};
+    int M = 0, N = 0;
+    int runs = 100;
+    int flush_mb = 64;
+    bool warm = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "hwM:N:s:E:b:r:F:")) != -1) {
+        switch (opt) {
+            case 'M':
+                M = atoi(optarg);
+                break;
+            case 'N':
+                N = atoi(optarg);
+                break;
+            case 's':
+                sim_s = atoi(optarg);
+                break;
+            case 'E':
+                sim_E = atoi(optarg);
+                break;
+            case 'b':
+                sim_b = atoi(optarg);
+                break;
+            case 'r':
+                runs = atoi(optarg);
+                break;
+            case 'F':
+                flush_mb = atoi(optarg);
+                break;
+            case 'w':
+                warm = true;
+                break;
+            case 'h':
+                usage(stdout, argv[0]);
+                return 0;
+            default:
+                usage(stderr, argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if ((M == 0) != (N == 0) || M < 0 || N < 0 || M > MAXN || N > MAXN ||
+        runs < 1 || flush_mb < 1) {
+        fprintf(stderr, "%s: -M and -N go together and must be 1 to %d, "
+                "-r and -F at least 1\n", argv[0], MAXN);
+        usage(stderr, argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    Csim* probe = csim_create(sim_s, sim_E, sim_b, "lru");
+    if (!probe) {
+        fprintf(stderr, "%s: bad cache\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    csim_destroy(probe);
+
+    if (!warm) {
+        flush_bytes = (size_t)flush_mb << 20;
+        flush = calloc(flush_bytes, 1);
+        if (!flush) {
+            perror(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    /* The native functions come first in func_list, the traced after */
+    native_registerFunctions();
+    int count = func_counter;
+    registerFunctions();
+    if (func_counter != 2 * count) {
+        fprintf(stderr, "%s: the two builds of trans.c disagree\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    open_counters(argv[0]);
+    tracehook_watch(matrices.A, sizeof(matrices.A));
+    tracehook_watch(matrices.B, sizeof(matrices.B));
+
+    if (M) {
+        compare(func_list, func_list + count, count, M, N, runs);
+    } else {
+        for (size_t k = 0; k < sizeof(shapes) / sizeof(shapes[0]); ++k) {
+            compare(func_list, func_list + count, count, shapes[k][0],
+                    shapes[k][1], runs);
+        }
+    }
+
+    tracehook_unwatch();
+    close_counters();
+    free((void*)flush);
+    return 0;
+}
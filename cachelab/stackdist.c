@@ -0,0 +1,298 @@
+/*
+ * stackdist.c - Single-pass LRU sweeps over many cache geometries
+ *
+ * For each block size, the previous access to the same block is found
+ * once with a hash table. For each set count, accesses are then laid out
+ * grouped by set (set 0's accesses first, in trace order, then set 1's,
+ * ...), and a Fenwick tree over that layout marks the latest access to
+ * every block. The stack distance of an access is the number of marks
+ * between its block's previous access and itself, which lie in the same
+ * set's range, so each access costs O(log n).
+ */
+#define _DEFAULT_SOURCE
+
+#include "stackdist.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tracefile.h"
+
+#define BATCH_SIZE 4096
+#define NONE SIZE_MAX
+
+static void* checked_malloc(size_t size) {
+    void* p = malloc(size ? size : 1);
+    if (!p) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+static bool parse_range(const char* p, int* lo, int* hi) {
+    char* end;
+    long a = strtol(p, &end, 10);
+    long b = a;
+
+    if (end == p) {
+        return false;
+    }
+    if (*end == '-') {
+        const char* q = end + 1;
+        b = strtol(q, &end, 10);
+        if (end == q) {
+            return false;
+        }
+    }
+    if ((*end != '\0' && *end != ',') || a < 0 || b < a || b > 1 << 16) {
+        return false;
+    }
+    *lo = (int)a;
+    *hi = (int)b;
+    return true;
+}
+
+bool parse_sweep(const char* spec, Sweep* sweep) {
+    *sweep = (Sweep){.s_min = 0, .s_max = 12, .e_min = 1, .e_max = 16,
+                     .b_min = 3, .b_max = 7};
+
+    for (const char* p = spec; *p;) {
+        bool ok;
+        if (strncmp(p, "s=", 2) == 0) {
+            ok = parse_range(p + 2, &sweep->s_min, &sweep->s_max);
+        } else if (strncmp(p, "E=", 2) == 0) {
+            ok = parse_range(p + 2, &sweep->e_min, &sweep->e_max) &&
+                 sweep->e_min >= 1;
+        } else if (strncmp(p, "b=", 2) == 0) {
+            ok = parse_range(p + 2, &sweep->b_min, &sweep->b_max);
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            return false;
+        }
+        p = strchr(p, ',') ? strchr(p, ',') + 1 : p + strlen(p);
+    }
+
+    return sweep->s_max <= 24 && sweep->b_max <= 32 && sweep->b_min >= 1;
+}
+
+static void* checked_realloc(void* p, size_t size) {
+    p = realloc(p, size);
+    if (!p) {
+        perror("realloc");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+/*
+ * load_addresses - Every cache access of the trace, two for M, with the
+ * last byte each touches in *ends
+ */
+static size_t* load_addresses(const char* filename, size_t* n,
+                              size_t** ends) {
+    Trace_reader* reader = trace_open(filename);
+    Access batch[BATCH_SIZE];
+    size_t count;
+    size_t capacity = 1 << 16;
+    size_t* addrs = checked_malloc(capacity * sizeof(*addrs));
+    *ends = checked_malloc(capacity * sizeof(**ends));
+
+    *n = 0;
+    while ((count = trace_read(reader, batch, BATCH_SIZE)) > 0) {
+        for (size_t i = 0; i < count; ++i) {
+            int times = batch[i].op == 'M' ? 2 : batch[i].op != 'I';
+            for (int k = 0; k < times; ++k) {
+                if (*n == capacity) {
+                    capacity *= 2;
+                    addrs = checked_realloc(addrs, capacity * sizeof(*addrs));
+                    *ends = checked_realloc(*ends, capacity * sizeof(**ends));
+                }
+                (*ends)[*n] = batch[i].addr +
+                              (batch[i].size > 1 ? batch[i].size - 1 : 0);
+                addrs[(*n)++] = batch[i].addr;
+            }
+        }
+    }
+
+    trace_close(reader);
+    return addrs;
+}
+
+/* find_previous - prev[i] = last j < i touching the same block, or NONE */
+static void find_previous(const size_t* addrs, size_t n, int block_bits,
+                          size_t* prev) {
+    size_t size = 16;
+    while (size < 2 * n) {
+        size <<= 1;
+    }
+    size_t* keys = calloc(size, sizeof(*keys));
+    size_t* last = checked_malloc(size * sizeof(*last));
+    if (!keys) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        size_t key = (addrs[i] >> block_bits) + 1;
+        size_t slot = (size_t)((key * 0x9e3779b97f4a7c15ull) >> 32) &
+                      (size - 1);
+        while (keys[slot] && keys[slot] != key) {
+            slot = (slot + 1) & (size - 1);
+        }
+        prev[i] = keys[slot] ? last[slot] : NONE;
+        keys[slot] = key;
+        last[slot] = i;
+    }
+
+    free(last);
+    free(keys);
+}
+
+static void fenwick_add(int* tree, size_t n, size_t pos, int delta) {
+    for (++pos; pos <= n; pos += pos & -pos) {
+        tree[pos] += delta;
+    }
+}
+
+/* fenwick_sum - Sum of positions [0, pos) */
+static long fenwick_sum(const int* tree, size_t pos) {
+    long sum = 0;
+    for (; pos > 0; pos -= pos & -pos) {
+        sum += tree[pos];
+    }
+    return sum;
+}
+
+/*
+ * sweep_sets - Stack distance histogram of one (b, s) geometry, then the
+ * results of every associativity of the sweep.
+ */
+static void sweep_sets(const size_t* addrs, const size_t* prev, size_t n,
+                       int block_bits, int set_bits, const Sweep* sweep,
+                       FILE* out) {
+    int e_max = sweep->e_max;
+    size_t sets = (size_t)1 << set_bits;
+    size_t set_mask = sets - 1;
+    size_t* offset = calloc(sets + 1, sizeof(*offset));
+    size_t* group = checked_malloc(n * sizeof(*group));
+    int* tree = calloc(n + 1, sizeof(*tree));
+    size_t* hist = calloc(e_max + 1, sizeof(*hist)); /* e_max: >= e_max */
+    size_t* distinct = calloc(sets, sizeof(*distinct));
+    size_t* fill_sets = calloc(e_max + 1, sizeof(*fill_sets));
+    if (!offset || !tree || !hist || !distinct || !fill_sets) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+
+    /* Lay the accesses out grouped by set, keeping trace order */
+    for (size_t i = 0; i < n; ++i) {
+        ++offset[((addrs[i] >> block_bits) & set_mask) + 1];
+    }
+    for (size_t s = 0; s < sets; ++s) {
+        offset[s + 1] += offset[s];
+    }
+    for (size_t i = 0; i < n; ++i) {
+        group[i] = offset[(addrs[i] >> block_bits) & set_mask]++;
+    }
+
+    size_t cold = 0;
+    for (size_t i = 0; i < n; ++i) {
+        size_t p = prev[i];
+        if (p == NONE) {
+            ++cold;
+            ++distinct[(addrs[i] >> block_bits) & set_mask];
+        } else {
+            long d = fenwick_sum(tree, group[i]) -
+                     fenwick_sum(tree, group[p] + 1);
+            ++hist[d < e_max ? d : e_max];
+            fenwick_add(tree, n, group[p], -1);
+        }
+        fenwick_add(tree, n, group[i], 1);
+    }
+
+    /* An E-way set fills min(E, distinct blocks) ways without evicting */
+    for (size_t s = 0; s < sets; ++s) {
+        ++fill_sets[distinct[s] < (size_t)e_max ? distinct[s] : e_max];
+    }
+
+    /* misses(E) = cold + accesses at distance >= E, starting at E = 1 */
+    size_t misses = cold;
+    for (int d = 1; d <= e_max; ++d) {
+        misses += hist[d];
+    }
+
+    size_t below = 0;      /* sets with fewer than E distinct blocks */
+    size_t below_sum = 0;  /* ... and their distinct blocks */
+    for (int e = 1; e <= e_max; ++e) {
+        below += fill_sets[e - 1];
+        below_sum += (size_t)(e - 1) * fill_sets[e - 1];
+        size_t fills = below_sum + (sets - below) * (size_t)e;
+        if (e >= sweep->e_min) {
+            fprintf(out, "b:%d s:%d E:%d size:%zu hits:%zu misses:%zu "
+                    "evictions:%zu\n", block_bits, set_bits, e,
+                    ((size_t)e << (set_bits + block_bits)), n - misses,
+                    misses, misses - fills);
+        }
+        misses -= hist[e];
+    }
+
+    free(fill_sets);
+    free(distinct);
+    free(hist);
+    free(tree);
+    free(group);
+    free(offset);
+}
+
+/*
+ * split_blocks - The accesses with each one crossing 2^block_bits byte
+ * blocks replaced by one access per block, as csim -a simulates them
+ */
+static size_t* split_blocks(const size_t* addrs, const size_t* ends,
+                            size_t n, int block_bits, size_t* split_n) {
+    size_t capacity = n;
+    size_t* blocks = checked_malloc(capacity * sizeof(*blocks));
+
+    *split_n = 0;
+    for (size_t i = 0; i < n; ++i) {
+        size_t first = addrs[i] >> block_bits;
+        size_t last = ends[i] >> block_bits;
+        for (size_t block = first; block <= last; ++block) {
+            if (*split_n == capacity) {
+                capacity *= 2;
+                blocks = checked_realloc(blocks, capacity * sizeof(*blocks));
+            }
+            blocks[(*split_n)++] = block << block_bits;
+        }
+    }
+    return blocks;
+}
+
+void run_sweep(const char* filename, const Sweep* sweep, bool split,
+               FILE* out) {
+    size_t n;
+    size_t* ends;
+    size_t* addrs = load_addresses(filename, &n, &ends);
+    size_t* prev = NULL;
+
+    for (int b = sweep->b_min; b <= sweep->b_max; ++b) {
+        size_t m = n;
+        size_t* blocks = split ? split_blocks(addrs, ends, n, b, &m) : addrs;
+        prev = checked_realloc(prev, (m ? m : 1) * sizeof(*prev));
+        find_previous(blocks, m, b, prev);
+        for (int s = sweep->s_min; s <= sweep->s_max; ++s) {
+            sweep_sets(blocks, prev, m, b, s, sweep, out);
+        }
+        if (blocks != addrs) {
+            free(blocks);
+        }
+    }
+
+    free(prev);
+    free(ends);
+    free(addrs);
+}
@@ -0,0 +1,38 @@
+/*
+ * stackdist.h - Single-pass LRU sweeps over many cache geometries
+ *
+ * Mattson et al. (1970): an access hits in an E-way LRU set exactly when
+ * fewer than E distinct blocks of its set were touched since the last
+ * access to its block. One pass that measures these per-set stack
+ * distances therefore gives the misses of every associativity at once;
+ * it is repeated for each set count and block size of the sweep.
+ */
+
+#ifndef CACHELAB_STACKDIST_H
+#define CACHELAB_STACKDIST_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+typedef struct sweep {
+    int s_min, s_max;   /* set index bits */
+    int e_min, e_max;   /* associativities */
+    int b_min, b_max;   /* block offset bits */
+} Sweep;
+
+/*
+ * Parse "s=0-10,E=1-16,b=4-6" (any subset, in any order; a single number
+ * is a one-value range). Unset ranges default to s=0-12, E=1-16, b=3-7.
+ * Returns false if the spec is malformed.
+ */
+bool parse_sweep(const char* spec, Sweep* sweep);
+
+/*
+ * Print one line per (b, s, E) of the sweep with the LRU hits, misses and
+ * evictions that csim -s s -E E -b b would report for the trace (csim -a
+ * if split, which makes accesses crossing blocks one access per block).
+ */
+void run_sweep(const char* filename, const Sweep* sweep, bool split,
+               FILE* out);
+
+#endif /* CACHELAB_STACKDIST_H */
@@ -2,6 +2,12 @@
  * test-trans.c - Checks the correctness and performance of all of the
  *     student's transpose functions and records the results for their
  *     official submitted version as well.
+ *
+ *     The functions are linked in from trans-traced.o, a build of trans.c
+ *     whose every load and store calls into tracehook.c. Accesses to A
+ *     and B are simulated in-process with libcsim, so neither valgrind
+ *     nor csim-ref is needed, and no files are written unless -t asks
+ *     for the traces.
  */
 #include <stdio.h>
 #include <stdlib.h>
@@ -12,7 +18,9 @@
 #include <getopt.h>
 #include <sys/types.h>
 #include "cachelab.h"
-#include <sys/wait.h> // fir WEXITSTATUS
+#include "libcsim.h"
+#include "tracefile.h"
+#include "tracehook.h"
 #include <limits.h> // for INT_MAX
 
 /* Maximum array dimension */
@@ -32,6 +40,7 @@ extern int func_counter;
 /* Globals set on the command line */
 static int M = 0;
 static int N = 0;
+static int keep_traces = 0;     /* -t: write each trace to trace.f<n> */
 
 /* The correctness and performance for the submitted transpose function */
 struct results {
@@ -41,22 +50,75 @@ struct results {
 };
 static struct results results = {-1, 0, INT_MAX};
 
+/* The matrices, laid out like tracegen's A and B: the set a block of B
+   maps to is that of the same block of A */
+static struct {
+    int A[MAXN][MAXN];
+    int B[MAXN][MAXN];
+} matrices __attribute__((aligned(4096)));
+static int C[MAXN * MAXN];
+
+/* The accesses of one transpose function to A and B */
+typedef struct trace_buffer {
+    Access* accesses;
+    size_t count;
+    size_t capacity;
+} Trace_buffer;
+
+static void record_access(const Access* access, void* arg)
+{
+    Trace_buffer* trace = arg;
+
+    if (trace->count == trace->capacity) {
+        trace->capacity = trace->capacity ? 2 * trace->capacity : 1 << 14;
+        trace->accesses = realloc(trace->accesses,
+                                  trace->capacity * sizeof(Access));
+        assert(trace->accesses);
+    }
+    trace->accesses[trace->count++] = *access;
+}
+
+/*
+ * validate - Check B against the baseline transpose of A; returns 1 if
+ *     they match
+ */
+static int validate(int fn, int A[N][M], int B[M][N])
+{
+    int (*expected)[N] = (int (*)[N])C;
+    int i, j;
+
+    correctTrans(M, N, A, expected);
+    for (i = 0; i < M; i++) {
+        for (j = 0; j < N; j++) {
+            if (B[i][j] != expected[i][j]) {
+                printf("Validation failed on function %d! Expected %d but got %d at B[%d][%d]\n",
+                       fn, expected[i][j], B[i][j], i, j);
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
 /* 
  * eval_perf - Evaluate the performance of the registered transpose functions
  */
 void eval_perf(unsigned int s, unsigned int E, unsigned int b)
 {
-    int i,flag;
-    unsigned int len, hits, misses, evictions;
-    unsigned long long int marker_start, marker_end, addr;
-    char buf[1000], cmd[255];
+    int i;
+    size_t j;
+    unsigned int hits, misses, evictions;
+    Csim_stats stats;
     char filename[128];
+    int (*A)[M] = (int (*)[M])matrices.A;
+    int (*B)[N] = (int (*)[N])matrices.B;
+    Trace_buffer trace = {NULL, 0, 0};
 
     registerFunctions(); 
 
-    /* Open the complete trace file */
-    FILE* full_trace_fp;  
-    FILE* part_trace_fp; 
+    /* Only accesses to the matrices count */
+    tracehook_watch(matrices.A, sizeof(int) * M * N);
+    tracehook_watch(matrices.B, sizeof(int) * M * N);
 
     /* Evaluate the performance of each registered transpose function */
 
@@ -66,22 +128,17 @@ void eval_perf(unsigned int s, unsigned int E, unsigned int b)
 
 
         printf("\nFunction %d (%d total)\nStep 1: Validating and generating memory traces\n",i,func_counter);
-        /* Use valgrind to generate the trace */
-
-        sprintf(cmd, "valgrind --tool=lackey --trace-mem=yes --log-fd=1 -v ./tracegen -M %d -N %d -F %d  > trace.tmp", M, N,i);
-        flag=WEXITSTATUS(system(cmd));
-        if (0!=flag) {
-            printf("Validation error at function %d! Run ./tracegen -M %d -N %d -F %d for details.\nSkipping performance evaluation for this function.\n",flag-1,M,N,i);      
+        initMatrix(M, N, A, B);
+        trace.count = 0;
+        tracehook_start(record_access, &trace);
+        (*func_list[i].func_ptr)(M, N, A, B);
+        tracehook_stop();
+
+        if (!validate(i, A, B)) {
+            printf("Validation error at function %d!\nSkipping performance evaluation for this function.\n", i);
             continue;
         }
 
-        /* Get the start and end marker addresses */
-        FILE* marker_fp = fopen(".marker", "r");
-        assert(marker_fp);
-        fscanf(marker_fp, "%llx %llx", &marker_start, &marker_end);
-        fclose(marker_fp);
-
-
         func_list[i].correct=1;
 
         /* Save the correctness of the transpose submission */
@@ -89,63 +146,30 @@ void eval_perf(unsigned int s, unsigned int E, unsigned int b)
             results.correct = 1;
         }
 
-        full_trace_fp = fopen("trace.tmp", "r");
-        assert(full_trace_fp);
-
-
-        /* Filtered trace for each transpose function goes in a separate file */
-        sprintf(filename, "trace.f%d", i);
-        part_trace_fp = fopen(filename, "w");
-        assert(part_trace_fp);
-    
-        /* Locate trace corresponding to the trans function */
-        flag = 0;
-        while (fgets(buf, 1000, full_trace_fp) != NULL) {
-
-            /* We are only interested in memory access instructions */
-            if (buf[0]==' ' && buf[2]==' ' &&
-                (buf[1]=='S' || buf[1]=='M' || buf[1]=='L' )) {
-                sscanf(buf+3, "%llx,%u", &addr, &len);
-        
-                /* If start marker found, set flag */
-                if (addr == marker_start)
-                    flag = 1;
-
-                /* Valgrind creates many spurious accesses to the
-                   stack that have nothing to do with the students
-                   code. At the moment, we are ignoring all stack
-                   accesses by using the simple filter of recording
-                   accesses to only the low 32-bit portion of the
-                   address space. At some point it would be nice to
-                   try to do more informed filtering so that would
-                   eliminate the valgrind stack references while
-                   include the student stack references. */
-                if (flag && addr < 0xffffffff) {
-                    fputs(buf, part_trace_fp);
-                }
-
-                /* if end marker found, close trace file */
-                if (addr == marker_end) {
-                    flag = 0;
-                    fclose(part_trace_fp);
-                    break;
-                }
+        /* With -t, keep each function's trace for csim and friends */
+        if (keep_traces) {
+            sprintf(filename, "trace.f%d", i);
+            FILE* part_trace_fp = fopen(filename, "w");
+            assert(part_trace_fp);
+            for (j = 0; j < trace.count; j++) {
+                fprintf(part_trace_fp, " %c %08zx,%d\n",
+                        trace.accesses[j].op, trace.accesses[j].addr,
+                        trace.accesses[j].size);
             }
+            fclose(part_trace_fp);
         }
-        fclose(full_trace_fp);
 
-        /* Run the reference simulator */
+        /* Simulate the trace on a cold cache */
         printf("Step 2: Evaluating performance (s=%d, E=%d, b=%d)\n", s, E, b);
-        char cmd[255];
-        sprintf(cmd, "./csim-ref -s %u -E %u -b %u -t trace.f%d > /dev/null", 
-                s, E, b, i);
-        system(cmd);
-    
-        /* Collect results from the reference simulator */
-        FILE* in_fp = fopen(".csim_results","r");
-        assert(in_fp);
-        fscanf(in_fp, "%u %u %u", &hits, &misses, &evictions);
-        fclose(in_fp);
+        Csim* csim = csim_create(s, E, b, "lru");
+        assert(csim);
+        csim_access_batch(csim, trace.accesses, trace.count);
+        csim_stats(csim, &stats);
+        csim_destroy(csim);
+        hits = stats.hits;
+        misses = stats.misses;
+        evictions = stats.evictions;
+
         func_list[i].num_hits = hits;
         func_list[i].num_misses = misses;
         func_list[i].num_evictions = evictions;
@@ -157,16 +181,18 @@ void eval_perf(unsigned int s, unsigned int E, unsigned int b)
             results.misses = misses;
         }
     }
-  
+
+    free(trace.accesses);
 }
 
 /*
  * usage - Print usage info
  */
 void usage(char *argv[]){
-    printf("Usage: %s [-h] -M <rows> -N <cols>\n", argv[0]);
+    printf("Usage: %s [-ht] -M <rows> -N <cols>\n", argv[0]);
     printf("Options:\n");
     printf("  -h          Print this help message.\n");
+    printf("  -t          Write each function's trace to trace.f<n>.\n");
     printf("  -M <rows>   Number of matrix rows (max %d)\n", MAXN);
     printf("  -N <cols>   Number of  matrix columns (max %d)\n", MAXN);
     printf("Example: %s -M 8 -N 8\n", argv[0]);       
@@ -199,7 +225,7 @@ int main(int argc, char* argv[])
 {
     char c;
 
-    while ((c = getopt(argc,argv,"M:N:h")) != -1) {
+    while ((c = getopt(argc,argv,"M:N:ht")) != -1) {
         switch(c) {
         case 'M':
             M = atoi(optarg);
@@ -207,6 +233,9 @@ int main(int argc, char* argv[])
         case 'N':
             N = atoi(optarg);
             break;
+        case 't':
+            keep_traces = 1;
+            break;
         case 'h':
             usage(argv);
             exit(0);
@@ -0,0 +1,93 @@
+/*
+ * tracebin.c - Convert lackey text traces to the compact binary format
+ *     described in tracefile.h, and back.
+ *
+ *     linux> ./tracebin traces/long.trace long.bin
+ *     linux> ./csim -s 5 -E 1 -b 5 -t long.bin
+ *     linux> ./tracebin -d long.bin long.txt
+ */
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "tracefile.h"
+
+#define BATCH_SIZE 4096
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [-hdi] <input> <output>\n", prog);
+    fprintf(stderr, "  -d  Decode a binary trace back to lackey text\n");
+    fprintf(stderr, "  -i  Keep instruction fetches (dropped by default)\n");
+}
+
+int main(int argc, char* argv[]) {
+    int opt;
+    bool decode = false;
+    bool keep_instructions = false;
+
+    while ((opt = getopt(argc, argv, "hdi")) != -1) {
+        switch (opt) {
+            case 'd':
+                decode = true;
+                break;
+            case 'i':
+                keep_instructions = true;
+                break;
+            case 'h':
+                usage(argv[0]);
+                return 0;
+            default:
+                usage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if (argc - optind != 2) {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    Trace_reader* reader = trace_open(argv[optind]);
+    FILE* out = fopen(argv[optind + 1], "wb");
+    if (!out) {
+        perror("fopen");
+        exit(EXIT_FAILURE);
+    }
+
+    Trace_writer* writer = decode ? NULL : trace_writer_open(out);
+    Access batch[BATCH_SIZE];
+    size_t count;
+    size_t records = 0;
+
+    while ((count = trace_read(reader, batch, BATCH_SIZE)) > 0) {
+        for (size_t i = 0; i < count; ++i) {
+            const Access* access = &batch[i];
+            if (access->op == 'I' && !keep_instructions) {
+                continue;
+            }
+            if (writer) {
+                trace_write(writer, access);
+            } else if (access->op == 'I') {
+                fprintf(out, "I  %08zx,%d\n", access->addr, access->size);
+            } else {
+                fprintf(out, " %c %08zx,%d\n", access->op, access->addr,
+                        access->size);
+            }
+            ++records;
+        }
+    }
+
+    if (writer) {
+        trace_writer_close(writer);
+    }
+    long in_bytes = (long)reader->length;
+    long out_bytes = ftell(out);
+    trace_close(reader);
+    fclose(out);
+
+    fprintf(stderr, "%zu accesses, %ld -> %ld bytes (%.2f bytes/access)\n",
+            records, in_bytes, out_bytes,
+            records ? (double)out_bytes / records : 0.0);
+    return 0;
+}
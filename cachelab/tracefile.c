@@ -0,0 +1,310 @@
+/*
+ * tracefile.c - Readers and writers for memory access traces
+ *
+ * Traces are mapped read-only and decoded in place: text records with a
+ * hand-written hex/decimal scanner that needs neither scanf nor the
+ * locale, binary records with a LEB128 varint decoder.
+ */
+#define _DEFAULT_SOURCE
+
+#include "tracefile.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Worst case bytes of one encoded record: opsize + two 64-bit varints */
+#define MAX_RECORD_BYTES (1 + 10 + 10)
+
+static const char op_chars[4] = {'L', 'S', 'M', 'I'};
+
+/*
+ * map_trace - Map the whole trace file read-only. Falls back to reading
+ * it into memory for files that cannot be mapped, such as pipes.
+ */
+static const char* map_trace(const char* filename, size_t* length,
+                             bool* mapped) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        perror("open");
+        exit(EXIT_FAILURE);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        *length = (size_t)st.st_size;
+        *mapped = true;
+        if (*length == 0) {
+            close(fd);
+            return NULL;
+        }
+
+        void* data = mmap(NULL, *length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            madvise(data, *length, MADV_SEQUENTIAL);
+            close(fd);
+            return data;
+        }
+    }
+
+    size_t capacity = 1 << 20;
+    char* buf = malloc(capacity);
+    ssize_t n;
+    *length = 0;
+    *mapped = false;
+    while (buf && (n = read(fd, buf + *length, capacity - *length)) > 0) {
+        *length += (size_t)n;
+        if (*length == capacity) {
+            capacity *= 2;
+            buf = realloc(buf, capacity);
+        }
+    }
+    if (!buf) {
+        perror("realloc");
+        exit(EXIT_FAILURE);
+    }
+    close(fd);
+    return buf;
+}
+
+/*
+ * parse_line - Decode one " L 7ff0005c8,8" or "I  0400d7d4,3" record of
+ * a lackey trace. Returns the start of the next line; *ok is false for
+ * anything that is not an access (valgrind chatter, malformed lines).
+ */
+static const char* parse_line(const char* p, const char* end, Access* access,
+                              bool* ok) {
+    char op = 0;
+    *ok = false;
+
+    if (end - p > 3) {
+        if (p[0] == 'I') {
+            op = 'I';
+        } else if (p[0] == ' ' && p[2] == ' ' &&
+                   (p[1] == 'L' || p[1] == 'S' || p[1] == 'M')) {
+            op = p[1];
+        }
+    }
+
+    if (op) {
+        const char* q = p + 2;
+        while (q < end && *q == ' ') {
+            ++q;
+        }
+
+        size_t addr = 0;
+        const char* digits = q;
+        for (; q < end; ++q) {
+            unsigned d = (unsigned)(*q - '0');
+            if (d >= 10) {
+                d = (unsigned)((*q | 0x20) - 'a');
+                if (d >= 6) {
+                    break;
+                }
+                d += 10;
+            }
+            addr = (addr << 4) | d;
+        }
+
+        if (q > digits && q < end && *q == ',') {
+            int size = 0;
+            for (++q; q < end && (unsigned)(*q - '0') < 10; ++q) {
+                size = size * 10 + (*q - '0');
+            }
+            access->op = op;
+            access->addr = addr;
+            access->size = size;
+            *ok = true;
+        }
+        p = q;
+    }
+
+    const char* newline = memchr(p, '\n', end - p);
+    return newline ? newline + 1 : end;
+}
+
+static bool read_varint(const char** pos, const char* end, uint64_t* value) {
+    const unsigned char* p = (const unsigned char*)*pos;
+    uint64_t v = 0;
+
+    for (int shift = 0; shift < 64 && (const char*)p < end; shift += 7) {
+        unsigned char byte = *p++;
+        v |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *pos = (const char*)p;
+            *value = v;
+            return true;
+        }
+    }
+    return false;
+}
+
+static size_t read_binary(Trace_reader* reader, Access* batch, size_t max) {
+    size_t count = 0;
+
+    while (count < max) {
+        uint64_t value;
+
+        if (reader->block_left == 0) {
+            uint64_t nbytes;
+            if (!read_varint(&reader->pos, reader->end, &value) ||
+                !read_varint(&reader->pos, reader->end, &nbytes)) {
+                reader->pos = reader->end;
+                break;
+            }
+            reader->block_left = (size_t)value;
+            reader->prev_addr = 0;
+            continue;
+        }
+
+        if (reader->pos >= reader->end) {
+            break;
+        }
+        unsigned char opsize = (unsigned char)*reader->pos++;
+        Access* access = &batch[count];
+        access->op = op_chars[opsize >> 6];
+        access->size = opsize & 0x3f;
+        if (access->size == 0) {
+            if (!read_varint(&reader->pos, reader->end, &value)) {
+                break;
+            }
+            access->size = (int)value;
+        }
+
+        if (!read_varint(&reader->pos, reader->end, &value)) {
+            break;
+        }
+        int64_t delta = (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+        reader->prev_addr += (size_t)delta;
+        access->addr = reader->prev_addr;
+
+        --reader->block_left;
+        ++count;
+    }
+
+    return count;
+}
+
+Trace_reader* trace_open(const char* filename) {
+    Trace_reader* reader = calloc(1, sizeof(*reader));
+    if (!reader) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+
+    reader->data = map_trace(filename, &reader->length, &reader->mapped);
+    reader->pos = reader->data;
+    reader->end = reader->data + reader->length;
+
+    if (reader->length >= TRACE_MAGIC_LEN &&
+        memcmp(reader->data, TRACE_MAGIC, TRACE_MAGIC_LEN) == 0) {
+        reader->binary = true;
+        reader->pos += TRACE_MAGIC_LEN;
+    }
+
+    return reader;
+}
+
+size_t trace_read(Trace_reader* reader, Access* batch, size_t max) {
+    if (reader->binary) {
+        return read_binary(reader, batch, max);
+    }
+
+    size_t count = 0;
+    while (count < max && reader->pos < reader->end) {
+        bool ok;
+        reader->pos = parse_line(reader->pos, reader->end, &batch[count], &ok);
+        count += ok;
+    }
+    return count;
+}
+
+void trace_close(Trace_reader* reader) {
+    if (reader->mapped) {
+        if (reader->data) {
+            munmap((void*)reader->data, reader->length);
+        }
+    } else {
+        free((void*)reader->data);
+    }
+    free(reader);
+}
+
+static void put_varint(Trace_writer* writer, uint64_t value) {
+    while (value >= 0x80) {
+        writer->buf[writer->used++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    writer->buf[writer->used++] = (unsigned char)value;
+}
+
+static void write_varint(FILE* fp, uint64_t value) {
+    while (value >= 0x80) {
+        fputc((int)(value & 0x7f) | 0x80, fp);
+        value >>= 7;
+    }
+    fputc((int)value, fp);
+}
+
+static void flush_block(Trace_writer* writer) {
+    if (writer->count == 0) {
+        return;
+    }
+    write_varint(writer->fp, writer->count);
+    write_varint(writer->fp, writer->used);
+    fwrite(writer->buf, 1, writer->used, writer->fp);
+    writer->count = 0;
+    writer->used = 0;
+    writer->prev_addr = 0;
+}
+
+Trace_writer* trace_writer_open(FILE* fp) {
+    Trace_writer* writer = calloc(1, sizeof(*writer));
+    if (writer) {
+        writer->buf = malloc(TRACE_BLOCK_RECORDS * MAX_RECORD_BYTES);
+    }
+    if (!writer || !writer->buf) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    writer->fp = fp;
+    fwrite(TRACE_MAGIC, 1, TRACE_MAGIC_LEN, fp);
+    return writer;
+}
+
+void trace_write(Trace_writer* writer, const Access* access) {
+    unsigned op;
+    switch (access->op) {
+        case 'L': op = 0; break;
+        case 'S': op = 1; break;
+        case 'M': op = 2; break;
+        default: op = 3; break;
+    }
+
+    bool small = access->size > 0 && access->size < 64;
+    writer->buf[writer->used++] =
+        (unsigned char)(op << 6 | (small ? (unsigned)access->size : 0));
+    if (!small) {
+        put_varint(writer, (uint64_t)(unsigned)access->size);
+    }
+
+    int64_t delta = (int64_t)(access->addr - writer->prev_addr);
+    put_varint(writer, ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63));
+    writer->prev_addr = access->addr;
+
+    if (++writer->count == TRACE_BLOCK_RECORDS) {
+        flush_block(writer);
+    }
+}
+
+void trace_writer_close(Trace_writer* writer) {
+    flush_block(writer);
+    fflush(writer->fp);
+    free(writer->buf);
+    free(writer);
+}
@@ -0,0 +1,69 @@
+/*
+ * tracefile.h - Readers and writers for memory access traces
+ *
+ * Two formats are understood and told apart by their first bytes:
+ *
+ * Text: valgrind lackey output, one access per line
+ *     I  0400d7d4,8
+ *      L 7ff0005c8,8
+ *
+ * Binary ("CLTRACE" + version 1), about 2-3 bytes per access:
+ *     file   := "CLTRACE\x01" block*
+ *     block  := varint(count) varint(nbytes) record{count}
+ *     record := opsize [varint(size)] zigzag-varint(addr - prev_addr)
+ *     opsize := op << 6 | size, op 0=L 1=S 2=M 3=I; a size of 0 means
+ *               the real size follows as a varint
+ * Varints are LEB128. prev_addr restarts at 0 in every block, so blocks
+ * can be decoded (or skipped, using nbytes) independently.
+ */
+
+#ifndef CACHELAB_TRACEFILE_H
+#define CACHELAB_TRACEFILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#define TRACE_MAGIC "CLTRACE\x01"
+#define TRACE_MAGIC_LEN 8
+#define TRACE_BLOCK_RECORDS 4096
+
+typedef struct access {
+    size_t addr;
+    int size;
+    char op;    /* 'L', 'S', 'M' or 'I' */
+} Access;
+
+typedef struct trace_reader {
+    const char* data;
+    const char* pos;
+    const char* end;
+    size_t length;
+    bool mapped;
+    bool binary;
+    size_t block_left;  /* records left in the current binary block */
+    size_t prev_addr;
+} Trace_reader;
+
+typedef struct trace_writer {
+    FILE* fp;
+    unsigned char* buf;  /* records of the block being built */
+    size_t used;
+    size_t count;
+    size_t prev_addr;
+} Trace_writer;
+
+/* Open a text or binary trace; exits on I/O errors */
+Trace_reader* trace_open(const char* filename);
+
+/* Decode up to max accesses into batch; returns 0 at the end */
+size_t trace_read(Trace_reader* reader, Access* batch, size_t max);
+
+void trace_close(Trace_reader* reader);
+
+/* Write a binary trace to fp, which stays owned by the caller */
+Trace_writer* trace_writer_open(FILE* fp);
+void trace_write(Trace_writer* writer, const Access* access);
+void trace_writer_close(Trace_writer* writer);
+
+#endif /* CACHELAB_TRACEFILE_H */
@@ -0,0 +1,109 @@
+/*
+ * tracehook.c - In-process memory traces of code built with
+ *     -fsanitize=thread
+ *
+ * Provides the entry points the instrumented code calls in place of the
+ * TSan runtime; see tracehook.h. This file itself must be compiled
+ * without -fsanitize=thread.
+ */
+#include "tracehook.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct range {
+    size_t start;
+    size_t size;
+} Range;
+
+/* Each thread traces on its own */
+static __thread Range ranges[TRACEHOOK_MAX_RANGES];
+static __thread int range_count;
+static __thread tracehook_fn hook;
+static __thread void* hook_arg;
+
+void tracehook_watch(const void* start, size_t size) {
+    if (range_count == TRACEHOOK_MAX_RANGES) {
+        fprintf(stderr, "tracehook: more than %d ranges\n",
+                TRACEHOOK_MAX_RANGES);
+        exit(EXIT_FAILURE);
+    }
+    ranges[range_count++] = (Range){(size_t)start, size};
+}
+
+void tracehook_unwatch(void) {
+    range_count = 0;
+}
+
+void tracehook_start(tracehook_fn fn, void* arg) {
+    hook_arg = arg;
+    hook = fn;
+}
+
+void tracehook_stop(void) {
+    hook = NULL;
+}
+
+static void record(const void* addr, size_t size, char op) {
+    size_t a = (size_t)addr;
+
+    if (!hook) {
+        return;
+    }
+    for (int i = 0; i < range_count; ++i) {
+        if (a - ranges[i].start < ranges[i].size) {
+            Access access = {.addr = a, .size = (int)size, .op = op};
+            hook(&access, hook_arg);
+            return;
+        }
+    }
+}
+
+/*
+ * The TSan ABI. Declared here rather than in a header: only compiler
+ * generated code calls these.
+ */
+void __tsan_init(void);
+void __tsan_func_entry(void* pc);
+void __tsan_func_exit(void);
+void __tsan_read_range(void* addr, unsigned long size);
+void __tsan_write_range(void* addr, unsigned long size);
+
+void __tsan_init(void) {
+}
+
+void __tsan_func_entry(void* pc) {
+}
+
+void __tsan_func_exit(void) {
+}
+
+void __tsan_read_range(void* addr, unsigned long size) {
+    record(addr, size, 'L');
+}
+
+void __tsan_write_range(void* addr, unsigned long size) {
+    record(addr, size, 'S');
+}
+
+#define ACCESS_HOOKS(n)                                                    \
+    void __tsan_read##n(void* addr);                                       \
+    void __tsan_write##n(void* addr);                                      \
+    void __tsan_read##n(void* addr) { record(addr, n, 'L'); }              \
+    void __tsan_write##n(void* addr) { record(addr, n, 'S'); }
+
+#define UNALIGNED_HOOKS(n)                                                 \
+    void __tsan_unaligned_read##n(void* addr);                             \
+    void __tsan_unaligned_write##n(void* addr);                            \
+    void __tsan_unaligned_read##n(void* addr) { record(addr, n, 'L'); }    \
+    void __tsan_unaligned_write##n(void* addr) { record(addr, n, 'S'); }
+
+ACCESS_HOOKS(1)
+ACCESS_HOOKS(2)
+ACCESS_HOOKS(4)
+ACCESS_HOOKS(8)
+ACCESS_HOOKS(16)
+UNALIGNED_HOOKS(2)
+UNALIGNED_HOOKS(4)
+UNALIGNED_HOOKS(8)
+UNALIGNED_HOOKS(16)
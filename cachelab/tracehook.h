@@ -0,0 +1,41 @@
+/*
+ * tracehook.h - In-process memory traces of code built with
+ *     -fsanitize=thread
+ *
+ * gcc's ThreadSanitizer pass puts a call to __tsan_readN or
+ * __tsan_writeN before every load and store it compiles. Linking such an
+ * object with tracehook.c instead of the TSan runtime turns those calls
+ * into a trace: while tracing is on, each access that starts inside a
+ * watched range is handed to a callback as a trace record ('L' or 'S'),
+ * and every other access (locals, the stack, the callee's own data) is
+ * dropped. No valgrind and no trace file are involved. The watched
+ * ranges and the hook belong to the calling thread, so several threads
+ * can trace at once.
+ *
+ *     linux> gcc -O0 -fsanitize=thread -c trans.c -o trans-traced.o
+ *     linux> gcc -o tool tool.c tracehook.c trans-traced.o
+ */
+
+#ifndef CACHELAB_TRACEHOOK_H
+#define CACHELAB_TRACEHOOK_H
+
+#include <stddef.h>
+
+#include "tracefile.h"
+
+#define TRACEHOOK_MAX_RANGES 4
+
+typedef void (*tracehook_fn)(const Access* access, void* arg);
+
+/* tracehook_watch - Trace accesses to [start, start + size) */
+void tracehook_watch(const void* start, size_t size);
+
+/* tracehook_unwatch - Forget all watched ranges */
+void tracehook_unwatch(void);
+
+/* tracehook_start - Call hook(access, arg) for each watched access */
+void tracehook_start(tracehook_fn hook, void* arg);
+
+void tracehook_stop(void);
+
+#endif /* CACHELAB_TRACEHOOK_H */
@@ -9,12 +9,15 @@
  */ 
 #include <stdio.h>
 #include "cachelab.h"
+#include "transpose.h"
 
 int is_transpose(int M, int N, int A[N][M], int B[M][N]);
 void transpose_8x8_32(int row, int col, int A[32][32], int B[32][32]);
 void transpose_8x8_diagonal_32(int row, int col, int A[32][32], int B[32][32]);
 void transpose_8x8_64(int row, int col, int A[64][64], int B[64][64]);
 void transpose_8x8_diagonal_64(int row, int col, int A[64][64], int B[64][64]);
+void transpose_blocked(int M, int N, int A[N][M], int B[M][N], int length,
+                       int width);
 
 /* 
  * transpose_submit - This is the solution transpose function that you
@@ -26,7 +29,7 @@ void transpose_8x8_diagonal_64(int row, int col, int A[64][64], int B[64][64]);
 char transpose_submit_desc[] = "Transpose submission";
 void transpose_submit(int M, int N, int A[N][M], int B[M][N])
 {
-    if (M == 32) {
+    if (M == 32 && N == 32) {
         for (int i = 0; i < 4; ++i) {
             for (int j = 0; j < 4; ++j) {
                 if (i != j) {
@@ -36,9 +39,7 @@ void transpose_submit(int M, int N, int A[N][M], int B[M][N])
                 }
             }
         }
-    }
-
-    if (M == 64) {
+    } else if (M == 64 && N == 64) {
         for (int i = 0; i < 4; ++i) {
             transpose_8x8_diagonal_64(i, i, A, B);
             transpose_8x8_64(i + 1, i, A, B);
@@ -66,22 +67,31 @@ void transpose_submit(int M, int N, int A[N][M], int B[M][N])
                 }
             }
         }
+    } else if (M == 61 && N == 67) {
+        /* found by ./tune-trans -M 61 -N 67 */
+        transpose_blocked(M, N, A, B, 14, 1);
+    } else {
+        transpose_tiled_lab(M, N, A, B);
     }
+}
 
-    if (M == 61) {
-        int length = 17;
-        int width = 4;
-        int i, j, ii, jj;
+/*
+ * transpose_blocked - Transpose A in tiles of length rows by width
+ *     columns, tile rows outermost
+ */
+void transpose_blocked(int M, int N, int A[N][M], int B[M][N], int length,
+                       int width)
+{
+    int i, j, ii, jj;
 
-        for (i = 0; i < N; i += length) {
-            for (j = 0; j < M; j += width) {
-                int i_end = (i + length < N) ? i + length : N;
-                int j_end = (j + width < M) ? j + width : M;
+    for (i = 0; i < N; i += length) {
+        for (j = 0; j < M; j += width) {
+            int i_end = (i + length < N) ? i + length : N;
+            int j_end = (j + width < M) ? j + width : M;
 
-                for (ii = i; ii < i_end; ++ii) {
-                    for (jj = j; jj < j_end; ++jj) {
-                        B[jj][ii] = A[ii][jj];
-                    }
+            for (ii = i; ii < i_end; ++ii) {
+                for (jj = j; jj < j_end; ++jj) {
+                    B[jj][ii] = A[ii][jj];
                 }
             }
         }
@@ -416,6 +426,12 @@ void trans(int M, int N, int A[N][M], int B[M][N])
 
 }
 
+char transpose_oblivious_desc[] = "Cache-oblivious recursive transpose";
+char transpose_tiled_lab_desc[] = "Geometry-tiled transpose (s=5, E=1, b=5)";
+char transpose_avx2_desc[] = "AVX2 8x8 tile transpose";
+char transpose_sse_desc[] = "SSE 4x4 tile transpose";
+char transpose_inplace_lab_desc[] = "In-place transpose, staged in B";
+
 /*
  * registerFunctions - This function registers your transpose
  *     functions with the driver.  At runtime, the driver will
@@ -427,6 +443,13 @@ void registerFunctions()
 {
     /* Register your solution function */
     registerTransFunction(transpose_submit, transpose_submit_desc); 
+
+    /* General kernels from transpose.c, for comparison */
+    registerTransFunction(transpose_oblivious, transpose_oblivious_desc);
+    registerTransFunction(transpose_tiled_lab, transpose_tiled_lab_desc);
+    registerTransFunction(transpose_avx2, transpose_avx2_desc);
+    registerTransFunction(transpose_sse, transpose_sse_desc);
+    registerTransFunction(transpose_inplace_lab, transpose_inplace_lab_desc);
 }
 
 /* 
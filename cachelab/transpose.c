@@ -0,0 +1,673 @@
+/*
+ * transpose.c - General transpose kernels for any M x N matrix
+ *
+ * Compiled at -O0 like trans.c, so every matrix access in the source is
+ * one access in the trace. Short local arrays stand in for registers:
+ * they live on the stack, which the trace leaves out.
+ */
+#define _GNU_SOURCE
+
+#include "transpose.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
+/* largest oblivious leaf, in rows and in columns */
+#define OBLIVIOUS_LEAF 4
+
+/* widest tile transpose_tiled uses: one line of 2^8 bytes */
+#define MAX_TILE 64
+
+/* the SIMD kernels work through blocks of this many rows and columns */
+#define SIMD_BLOCK 64
+
+/* transpose_leaf - B = A^T over rows i0..i1 and columns j0..j1 of A */
+static void transpose_leaf(int M, int N, int A[N][M], int B[M][N], int i0,
+                           int i1, int j0, int j1)
+{
+    int row[OBLIVIOUS_LEAF];
+    int i, j;
+
+    /* Read A's row before writing B, in case they share a set */
+    for (i = i0; i < i1; i++) {
+        for (j = j0; j < j1; j++) {
+            row[j - j0] = A[i][j];
+        }
+        for (j = j0; j < j1; j++) {
+            B[j][i] = row[j - j0];
+        }
+    }
+}
+
+static void transpose_recurse(int M, int N, int A[N][M], int B[M][N],
+                              int i0, int i1, int j0, int j1)
+{
+    int rows = i1 - i0;
+    int cols = j1 - j0;
+
+    if (rows <= OBLIVIOUS_LEAF && cols <= OBLIVIOUS_LEAF) {
+        transpose_leaf(M, N, A, B, i0, i1, j0, j1);
+    } else if (rows >= cols) {
+        transpose_recurse(M, N, A, B, i0, i0 + rows / 2, j0, j1);
+        transpose_recurse(M, N, A, B, i0 + rows / 2, i1, j0, j1);
+    } else {
+        transpose_recurse(M, N, A, B, i0, i1, j0, j0 + cols / 2);
+        transpose_recurse(M, N, A, B, i0, i1, j0 + cols / 2, j1);
+    }
+}
+
+void transpose_oblivious(int M, int N, int A[N][M], int B[M][N])
+{
+    transpose_recurse(M, N, A, B, 0, N, 0, M);
+}
+
+/*
+ * Lines of a tile are tracked by (first line, last line) of each row
+ * segment; tiles are at most MAX_TILE rows and a segment of at most one
+ * line's worth of ints touches at most two lines.
+ */
+typedef struct footprint {
+    uintptr_t sets[2 * MAX_TILE];
+    int count;
+} Footprint;
+
+/*
+ * add_rows - Add the sets of the lines under columns j..j + len of rows
+ * i..i + rows of a matrix whose rows are stride ints apart. Returns 0 if
+ * some set would then hold more than E of these lines.
+ */
+static int add_rows(Footprint* fp, const int* base, int stride, int i,
+                    int rows, int j, int len, int s, int E, int b)
+{
+    uintptr_t mask = ((uintptr_t)1 << s) - 1;
+    int r, k;
+
+    for (r = i; r < i + rows; r++) {
+        uintptr_t first = (uintptr_t)(base + (intptr_t)r * stride + j) >> b;
+        uintptr_t last = (uintptr_t)(base + (intptr_t)r * stride + j + len -
+                                     1) >> b;
+        uintptr_t line;
+        for (line = first; line <= last; line++) {
+            int same = 0;
+            for (k = 0; k < fp->count; k++) {
+                same += fp->sets[k] == (line & mask);
+            }
+            if (same >= E) {
+                return 0;
+            }
+            fp->sets[fp->count++] = line & mask;
+        }
+    }
+    return 1;
+}
+
+/*
+ * fitting_rows - Most rows, up to limit, starting at row 0 of a matrix
+ * with rows stride ints apart whose first len ints fit in the cache
+ * without conflicts
+ */
+static int fitting_rows(const int* base, int stride, int len, int limit,
+                        int s, int E, int b)
+{
+    Footprint fp = {.count = 0};
+    int rows = 0;
+
+    while (rows < limit && add_rows(&fp, base, stride, rows, 1, 0, len, s,
+                                    E, b)) {
+        rows++;
+    }
+    return rows > 0 ? rows : 1;
+}
+
+/* shares_sets - Whether a w x w tile of A at (i, j) and its image in B
+   have lines in a common set */
+static int shares_sets(int M, int N, int A[N][M], int B[M][N], int i, int j,
+                       int w, int s, int b)
+{
+    Footprint a = {.count = 0};
+    Footprint t = {.count = 0};
+    int k, l;
+
+    /* More ways than lines never fails: only the sets are wanted */
+    add_rows(&a, &A[0][0], M, i, w, j, w, s, 2 * w + 1, b);
+    add_rows(&t, &B[0][0], N, j, w, i, w, s, 2 * w + 1, b);
+    for (k = 0; k < a.count; k++) {
+        for (l = 0; l < t.count; l++) {
+            if (a.sets[k] == t.sets[l]) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/* line_width - The ints in a line of 2^b bytes, kept to 1..MAX_TILE */
+static int line_width(int b)
+{
+    int line_ints = (1 << b) / (int)sizeof(int);
+
+    return line_ints < MAX_TILE ? (line_ints > 0 ? line_ints : 1) : MAX_TILE;
+}
+
+void transpose_tiled(int M, int N, int A[N][M], int B[M][N], int s, int E,
+                     int b)
+{
+    int w = line_width(b);
+    int row[MAX_TILE];
+    int i, j, r, c, tmp;
+
+    w = fitting_rows(&A[0][0], M, w, w, s, E, b);
+    w = fitting_rows(&B[0][0], N, w, w, s, E, b);
+
+    for (i = 0; i < N; i += w) {
+        for (j = 0; j < M; j += w) {
+            int h = N - i < w ? N - i : w;
+            int cw = M - j < w ? M - j : w;
+
+            if (h == w && cw == w && shares_sets(M, N, A, B, i, j, w, s, b)) {
+                /* A's rows go to B's rows, then the tile flips in B */
+                for (r = 0; r < w; r++) {
+                    for (c = 0; c < w; c++) {
+                        row[c] = A[i + r][j + c];
+                    }
+                    for (c = 0; c < w; c++) {
+                        B[j + r][i + c] = row[c];
+                    }
+                }
+                for (r = 0; r < w; r++) {
+                    for (c = 0; c < r; c++) {
+                        tmp = B[j + r][i + c];
+                        B[j + r][i + c] = B[j + c][i + r];
+                        B[j + c][i + r] = tmp;
+                    }
+                }
+                continue;
+            }
+
+            for (r = 0; r < h; r++) {
+                for (c = 0; c < cw; c++) {
+                    row[c] = A[i + r][j + c];
+                }
+                for (c = 0; c < cw; c++) {
+                    B[j + c][i + r] = row[c];
+                }
+            }
+        }
+    }
+}
+
+void transpose_tiled_lab(int M, int N, int A[N][M], int B[M][N])
+{
+    transpose_tiled(M, N, A, B, 5, 1, 5);
+}
+
+/*
+ * swap_tiles - Square X in place: each w x w tile above the diagonal
+ * trades places with its mirror image below it, a row of one against a
+ * column of the other; diagonal tiles swap within themselves
+ */
+static void swap_tiles(int N, int X[N][N], int w)
+{
+    int bi, bj, i, j, tmp;
+
+    for (bi = 0; bi < N; bi += w) {
+        for (bj = bi; bj < N; bj += w) {
+            int i_end = bi + w < N ? bi + w : N;
+            int j_end = bj + w < N ? bj + w : N;
+
+            for (i = bi; i < i_end; i++) {
+                for (j = bj == bi ? i + 1 : bj; j < j_end; j++) {
+                    tmp = X[i][j];
+                    X[i][j] = X[j][i];
+                    X[j][i] = tmp;
+                }
+            }
+        }
+    }
+}
+
+/*
+ * follow_cycles - Rectangular X in place. Element k of the N x M matrix
+ * belongs at k * N mod (MN - 1) of the M x N one; each cycle of that
+ * permutation is walked once, carrying one element at a time, with a
+ * bit per element marking those already moved
+ */
+static int follow_cycles(int M, int N, int* X)
+{
+    size_t last = (size_t)M * N - 1;
+    unsigned char* moved;
+    size_t start, k, next;
+    int carry, tmp;
+
+    if (last < 2) {
+        return 0;
+    }
+    moved = calloc(last / 8 + 1, 1);
+    if (!moved) {
+        return -1;
+    }
+    for (start = 1; start < last; start++) {
+        if (moved[start / 8] & (1 << start % 8)) {
+            continue;
+        }
+        k = start;
+        carry = X[start];
+        do {
+            next = k * N % last;
+            tmp = X[next];
+            X[next] = carry;
+            carry = tmp;
+            moved[next / 8] |= 1 << next % 8;
+            k = next;
+        } while (k != start);
+    }
+    free(moved);
+    return 0;
+}
+
+int transpose_inplace(int M, int N, int* X, int s, int E, int b)
+{
+    int w;
+
+    if (M != N) {
+        return follow_cycles(M, N, X);
+    }
+    w = line_width(b);
+    w = fitting_rows(X, N, w, w, s, E, b);
+    swap_tiles(N, (int (*)[N])X, w);
+    return 0;
+}
+
+void transpose_inplace_lab(int M, int N, int A[N][M], int B[M][N])
+{
+    const int* a = &A[0][0];
+    int* x = &B[0][0];
+    int line[MAX_TILE];
+    int w = line_width(5);
+    int size = M * N;
+    int k, n, j;
+
+    /*
+     * Copied in traced code, not with memcpy, so the copy is scored too.
+     * A and B share sets, so each line goes through the stack rather
+     * than element by element.
+     */
+    for (k = 0; k < size; k += w) {
+        n = size - k < w ? size - k : w;
+        for (j = 0; j < n; j++) {
+            line[j] = a[k + j];
+        }
+        for (j = 0; j < n; j++) {
+            x[k + j] = line[j];
+        }
+    }
+    transpose_inplace(M, N, x, 5, 1, 5);
+}
+
+/*
+ * A w x w tile kernel: transposes the tile at a, whose rows are lda ints
+ * apart, into b, whose rows are ldb ints apart
+ */
+typedef void (*tile_fn)(const int* a, int lda, int* b, int ldb);
+
+#ifdef HAVE_X86_SIMD
+/* tile_4x4_sse - Four rows in, four columns out; SSE2 is always there */
+static void tile_4x4_sse(const int* a, int lda, int* b, int ldb)
+{
+    __m128i r0 = _mm_loadu_si128((const __m128i*)(a + 0 * lda));
+    __m128i r1 = _mm_loadu_si128((const __m128i*)(a + 1 * lda));
+    __m128i r2 = _mm_loadu_si128((const __m128i*)(a + 2 * lda));
+    __m128i r3 = _mm_loadu_si128((const __m128i*)(a + 3 * lda));
+
+    /* a00 a10 a01 a11, a20 a30 a21 a31, a02 a12 a03 a13, ... */
+    __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+    __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+    __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+    __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+
+    _mm_storeu_si128((__m128i*)(b + 0 * ldb), _mm_unpacklo_epi64(t0, t1));
+    _mm_storeu_si128((__m128i*)(b + 1 * ldb), _mm_unpackhi_epi64(t0, t1));
+    _mm_storeu_si128((__m128i*)(b + 2 * ldb), _mm_unpacklo_epi64(t2, t3));
+    _mm_storeu_si128((__m128i*)(b + 3 * ldb), _mm_unpackhi_epi64(t2, t3));
+}
+
+/*
+ * tile_8x8_avx2 - The 4x4 network in each 128-bit lane, then the lanes
+ * of rows 0-3 and 4-7 are swapped into place
+ */
+__attribute__((target("avx2")))
+static void tile_8x8_avx2(const int* a, int lda, int* b, int ldb)
+{
+    __m256i r0 = _mm256_loadu_si256((const __m256i*)(a + 0 * lda));
+    __m256i r1 = _mm256_loadu_si256((const __m256i*)(a + 1 * lda));
+    __m256i r2 = _mm256_loadu_si256((const __m256i*)(a + 2 * lda));
+    __m256i r3 = _mm256_loadu_si256((const __m256i*)(a + 3 * lda));
+    __m256i r4 = _mm256_loadu_si256((const __m256i*)(a + 4 * lda));
+    __m256i r5 = _mm256_loadu_si256((const __m256i*)(a + 5 * lda));
+    __m256i r6 = _mm256_loadu_si256((const __m256i*)(a + 6 * lda));
+    __m256i r7 = _mm256_loadu_si256((const __m256i*)(a + 7 * lda));
+
+    __m256i t0 = _mm256_unpacklo_epi32(r0, r1);
+    __m256i t1 = _mm256_unpackhi_epi32(r0, r1);
+    __m256i t2 = _mm256_unpacklo_epi32(r2, r3);
+    __m256i t3 = _mm256_unpackhi_epi32(r2, r3);
+    __m256i t4 = _mm256_unpacklo_epi32(r4, r5);
+    __m256i t5 = _mm256_unpackhi_epi32(r4, r5);
+    __m256i t6 = _mm256_unpacklo_epi32(r6, r7);
+    __m256i t7 = _mm256_unpackhi_epi32(r6, r7);
+
+    /* u0 = a00 a10 a20 a30 | a04 a14 a24 a34, and so on */
+    __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+    __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+    __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+    __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+    __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+    __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+    __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+    __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+
+    _mm256_storeu_si256((__m256i*)(b + 0 * ldb),
+                        _mm256_permute2x128_si256(u0, u4, 0x20));
+    _mm256_storeu_si256((__m256i*)(b + 1 * ldb),
+                        _mm256_permute2x128_si256(u1, u5, 0x20));
+    _mm256_storeu_si256((__m256i*)(b + 2 * ldb),
+                        _mm256_permute2x128_si256(u2, u6, 0x20));
+    _mm256_storeu_si256((__m256i*)(b + 3 * ldb),
+                        _mm256_permute2x128_si256(u3, u7, 0x20));
+    _mm256_storeu_si256((__m256i*)(b + 4 * ldb),
+                        _mm256_permute2x128_si256(u0, u4, 0x31));
+    _mm256_storeu_si256((__m256i*)(b + 5 * ldb),
+                        _mm256_permute2x128_si256(u1, u5, 0x31));
+    _mm256_storeu_si256((__m256i*)(b + 6 * ldb),
+                        _mm256_permute2x128_si256(u2, u6, 0x31));
+    _mm256_storeu_si256((__m256i*)(b + 7 * ldb),
+                        _mm256_permute2x128_si256(u3, u7, 0x31));
+}
+#else
+static void tile_4x4_sse(const int* a, int lda, int* b, int ldb)
+{
+    int i, j;
+
+    for (i = 0; i < 4; i++) {
+        for (j = 0; j < 4; j++) {
+            b[j * ldb + i] = a[i * lda + j];
+        }
+    }
+}
+#endif
+
+/*
+ * transpose_tiles - Columns j0..j1 of A (rows j0..j1 of B) in whole w x w
+ * tiles with tile, SIMD_BLOCK square blocks at a time; the rows and
+ * columns left over at the bottom and right of each block one int at a
+ * time
+ */
+static void transpose_tiles(int M, int N, int A[N][M], int B[M][N], int w,
+                            tile_fn tile, int j0, int j1)
+{
+    int ii, jj, i, j;
+
+    for (ii = 0; ii < N; ii += SIMD_BLOCK) {
+        for (jj = j0; jj < j1; jj += SIMD_BLOCK) {
+            int i_end = ii + SIMD_BLOCK < N ? ii + SIMD_BLOCK : N;
+            int j_end = jj + SIMD_BLOCK < j1 ? jj + SIMD_BLOCK : j1;
+            int i_full = ii + (i_end - ii) / w * w;
+            int j_full = jj + (j_end - jj) / w * w;
+
+            for (i = ii; i < i_full; i += w) {
+                for (j = jj; j < j_full; j += w) {
+                    tile(&A[i][j], M, &B[j][i], N);
+                }
+            }
+            for (i = ii; i < i_end; i++) {
+                for (j = i < i_full ? j_full : jj; j < j_end; j++) {
+                    B[j][i] = A[i][j];
+                }
+            }
+        }
+    }
+}
+
+/* widest_tile - The widest tile kernel the CPU runs, and its width */
+static tile_fn widest_tile(int* w)
+{
+#ifdef HAVE_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        *w = 8;
+        return tile_8x8_avx2;
+    }
+#endif
+    *w = 4;
+    return tile_4x4_sse;
+}
+
+void transpose_sse(int M, int N, int A[N][M], int B[M][N])
+{
+    transpose_tiles(M, N, A, B, 4, tile_4x4_sse, 0, M);
+}
+
+void transpose_avx2(int M, int N, int A[N][M], int B[M][N])
+{
+    int w;
+    tile_fn tile = widest_tile(&w);
+
+    transpose_tiles(M, N, A, B, w, tile, 0, M);
+}
+
+/*
+ * The pool splits A's columns, which are B's rows, into one band of
+ * whole SIMD_BLOCKs per thread. Thread 0 is the caller.
+ */
+typedef struct pool_job {
+    int touch;          /* zero B's band instead of transposing */
+    int M, N;
+    int* A;
+    int* B;
+} Pool_job;
+
+typedef struct pool_worker {
+    Transpose_pool* pool;
+    int index;
+} Pool_worker;
+
+struct transpose_pool {
+    int threads;
+    tile_fn tile;
+    int w;
+    pthread_t* ids;
+    Pool_worker* workers;
+    pthread_mutex_t lock;
+    pthread_cond_t start;       /* a new job or quit */
+    pthread_cond_t done;        /* pending reached 0 */
+    unsigned generation;        /* jobs posted so far */
+    int pending;                /* workers other than the caller still busy */
+    int quit;
+    Pool_job job;
+};
+
+/* run_band - Thread index's part of job */
+static void run_band(const Transpose_pool* pool, const Pool_job* job,
+                     int index)
+{
+    int M = job->M;
+    int N = job->N;
+    int blocks = (M + SIMD_BLOCK - 1) / SIMD_BLOCK;
+    int j0 = (int)((long long)blocks * index / pool->threads) * SIMD_BLOCK;
+    int j1 = (int)((long long)blocks * (index + 1) / pool->threads) *
+             SIMD_BLOCK;
+    int j;
+
+    j1 = j1 < M ? j1 : M;
+    if (j0 >= j1) {
+        return;
+    }
+    if (job->touch) {
+        for (j = j0; j < j1; j++) {
+            memset(job->B + (size_t)j * N, 0, (size_t)N * sizeof(int));
+        }
+        return;
+    }
+    transpose_tiles(M, N, (int (*)[M])job->A, (int (*)[N])job->B, pool->w,
+                    pool->tile, j0, j1);
+}
+
+static void* pool_main(void* arg)
+{
+    Pool_worker* worker = arg;
+    Transpose_pool* pool = worker->pool;
+    unsigned seen = 0;
+    Pool_job job;
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        while (pool->generation == seen && !pool->quit) {
+            pthread_cond_wait(&pool->start, &pool->lock);
+        }
+        if (pool->quit) {
+            pthread_mutex_unlock(&pool->lock);
+            return NULL;
+        }
+        seen = pool->generation;
+        job = pool->job;
+        pthread_mutex_unlock(&pool->lock);
+
+        run_band(pool, &job, worker->index);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->pending == 0) {
+            pthread_cond_signal(&pool->done);
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+/* pin - Bind thread to the index-th CPU, wrapping, of those in allowed */
+static void pin(pthread_t thread, const cpu_set_t* allowed, int index)
+{
+    int count = CPU_COUNT(allowed);
+    cpu_set_t one;
+    int cpu;
+
+    if (count == 0) {
+        return;
+    }
+    index %= count;
+    for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, allowed) && index-- == 0) {
+            CPU_ZERO(&one);
+            CPU_SET(cpu, &one);
+            /* Best effort: an unpinned worker still gives right results */
+            pthread_setaffinity_np(thread, sizeof(one), &one);
+            return;
+        }
+    }
+}
+
+Transpose_pool* transpose_pool_create(int threads)
+{
+    Transpose_pool* pool;
+    cpu_set_t allowed;
+    int i;
+
+    if (threads < 1) {
+        return NULL;
+    }
+    pool = calloc(1, sizeof(*pool));
+    if (!pool) {
+        return NULL;
+    }
+    pool->threads = threads;
+    pool->tile = widest_tile(&pool->w);
+    pool->ids = malloc(threads * sizeof(*pool->ids));
+    pool->workers = malloc(threads * sizeof(*pool->workers));
+    if (!pool->ids || !pool->workers) {
+        free(pool->ids);
+        free(pool->workers);
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed)) {
+        CPU_ZERO(&allowed);
+    }
+
+    for (i = 1; i < threads; i++) {
+        pool->workers[i] = (Pool_worker){pool, i};
+        if (pthread_create(&pool->ids[i], NULL, pool_main,
+                           &pool->workers[i])) {
+            /* Run with the threads that did start */
+            pool->threads = i;
+            break;
+        }
+        pin(pool->ids[i], &allowed, i);
+    }
+    return pool;
+}
+
+void transpose_pool_destroy(Transpose_pool* pool)
+{
+    int i;
+
+    if (!pool) {
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+    for (i = 1; i < pool->threads; i++) {
+        pthread_join(pool->ids[i], NULL);
+    }
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->start);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->workers);
+    free(pool->ids);
+    free(pool);
+}
+
+/* pool_run - Post job, do the caller's band and wait for the rest */
+static void pool_run(Transpose_pool* pool, Pool_job job)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->job = job;
+    pool->pending = pool->threads - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    run_band(pool, &job, 0);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending > 0) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+int transpose_pool_threads(const Transpose_pool* pool)
+{
+    return pool->threads;
+}
+
+void transpose_pool_touch(Transpose_pool* pool, int M, int N, int B[M][N])
+{
+    pool_run(pool, (Pool_job){1, M, N, NULL, &B[0][0]});
+}
+
+void transpose_parallel(Transpose_pool* pool, int M, int N, int A[N][M],
+                        int B[M][N])
+{
+    pool_run(pool, (Pool_job){0, M, N, &A[0][0], &B[0][0]});
+}
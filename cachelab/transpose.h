@@ -0,0 +1,94 @@
+/*
+ * transpose.h - General transpose kernels for any M x N matrix
+ *
+ * Like the functions in trans.c, each kernel computes B = A^T for
+ * int A[N][M] and int B[M][N], so they can be registered with
+ * registerTransFunction() and scored by test-trans.
+ */
+
+#ifndef CACHELAB_TRANSPOSE_H
+#define CACHELAB_TRANSPOSE_H
+
+/*
+ * transpose_oblivious - Cache-oblivious transpose: halve the longer side
+ * of the submatrix until it is at most OBLIVIOUS_LEAF square, with no
+ * knowledge of the cache
+ */
+void transpose_oblivious(int M, int N, int A[N][M], int B[M][N]);
+
+/*
+ * transpose_tiled - Square tiles sized for a cache of 2^s sets of E ways
+ * of 2^b bytes: a tile is at most one cache line wide, and no taller
+ * than the rows of A or of B whose lines can share the cache without
+ * conflicting. Tiles whose A and B lines compete for the same sets
+ * (such as the diagonal tiles of a square matrix) are copied into B
+ * row-wise and then transposed inside B.
+ */
+void transpose_tiled(int M, int N, int A[N][M], int B[M][N], int s, int E,
+                     int b);
+
+/* transpose_tiled_lab - transpose_tiled for the lab's s=5, E=1, b=5 */
+void transpose_tiled_lab(int M, int N, int A[N][M], int B[M][N]);
+
+/*
+ * transpose_inplace - Turn X, the N x M matrix A[N][M] stored row by
+ * row, into A^T (M x N) in the same memory. Square matrices swap pairs
+ * of tiles sized as transpose_tiled() sizes them for a cache of 2^s
+ * sets of E ways of 2^b bytes. Rectangular ones follow the cycles of
+ * the permutation, using MN bits of scratch to mark moved elements.
+ * Returns 0, or -1 (X unchanged) if the scratch cannot be allocated.
+ */
+int transpose_inplace(int M, int N, int* X, int s, int E, int b);
+
+/*
+ * transpose_inplace_lab - transpose_inplace() for the lab's cache, in
+ * the form registerTransFunction() takes: A is copied into B a line at
+ * a time, and B is transposed in place
+ */
+void transpose_inplace_lab(int M, int N, int A[N][M], int B[M][N]);
+
+/*
+ * transpose_avx2 - 8x8 tiles through AVX2 registers (unpack and
+ * permute), falling back to transpose_sse() on CPUs without AVX2
+ */
+void transpose_avx2(int M, int N, int A[N][M], int B[M][N]);
+
+/* transpose_sse - 4x4 tiles through SSE registers */
+void transpose_sse(int M, int N, int A[N][M], int B[M][N]);
+
+/*
+ * A pool of threads for transpose_parallel(). Each thread owns a fixed
+ * band of B's rows, whole blocks of the tiles transpose_avx2() uses, so
+ * a B first touched with transpose_pool_touch() has each page on the
+ * NUMA node of the thread that later writes it. Worker i is pinned to
+ * the i-th CPU the process may use, so it cannot migrate between the
+ * touch and the transpose. The caller is not pinned; its band stays
+ * local only if the caller pins itself.
+ *
+ *     Transpose_pool* pool = transpose_pool_create(8);
+ *     transpose_pool_touch(pool, M, N, B);
+ *     transpose_parallel(pool, M, N, A, B);
+ *     transpose_pool_destroy(pool);
+ */
+typedef struct transpose_pool Transpose_pool;
+
+/*
+ * transpose_pool_create - Start threads - 1 workers, each pinned to a
+ * CPU; the caller is the last thread. Returns NULL if threads < 1 or
+ * out of memory.
+ */
+Transpose_pool* transpose_pool_create(int threads);
+
+void transpose_pool_destroy(Transpose_pool* pool);
+
+/* transpose_pool_threads - Threads the pool runs on, caller included */
+int transpose_pool_threads(const Transpose_pool* pool);
+
+/* transpose_pool_touch - Zero B, each band from the thread that owns it */
+void transpose_pool_touch(Transpose_pool* pool, int M, int N, int B[M][N]);
+
+/* transpose_parallel - transpose_avx2() spread over the pool's threads */
+void transpose_parallel(Transpose_pool* pool, int M, int N, int A[N][M],
+                        int B[M][N]);
+
+#endif /* CACHELAB_TRANSPOSE_H */
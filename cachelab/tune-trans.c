@@ -0,0 +1,556 @@
+/*
+ * tune-trans.c - Find the best tiling for transpose_blocked() in trans.c
+ *
+ *     linux> ./tune-trans -M 61 -N 67
+ *     linux> ./tune-trans -M 200 -N 150 -s 8 -E 4 -b 6 -j 8
+ *
+ * Every candidate (length, width) runs the real kernel from
+ * trans-traced.o and is simulated in-process with libcsim, on a cold
+ * cache and with A and B laid out as test-trans lays them out (B starts
+ * a multiple of 256KB after A). Candidates are spread over threads.
+ *
+ * Simulating every tiling is wasteful, so a cheap model ranks them
+ * first. For a sample of tile bands it counts, per cache set and tile,
+ * the lines that must stay cached for the whole tile: the tile's lines
+ * of B, which every row of A revisits, and lines of A the next tile
+ * finishes, plus one for the A line being read. In sets that hold them,
+ * a line costs one miss, or the fraction of it the tile uses if the
+ * rest is used soon enough to still be cached. In oversubscribed sets
+ * every access misses. The best -k tilings by this estimate are
+ * simulated, then a local search simulates the neighbours (length and
+ * width +-1) of the best tiling found until none improves on it. -x
+ * simulates everything instead.
+ */
+#define _DEFAULT_SOURCE
+
+#include <getopt.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "libcsim.h"
+#include "tracehook.h"
+
+#define MAX_DIM 8192
+#define MAX_THREADS 64
+
+/* B starts this far after A (rounded up to fit A) */
+#define B_ALIGN ((size_t)256 << 10)
+
+/* tilings printed at the end */
+#define TOP_COUNT 5
+
+/* bands of tiles the model looks at, evenly spaced */
+#define MODEL_BANDS 4
+
+/* The kernel being tuned, from trans.c */
+void transpose_blocked(int M, int N, int A[N][M], int B[M][N], int length,
+                       int width);
+
+typedef struct problem {
+    int M, N;
+    int s, E, b;
+    const char* policy;
+    size_t b_offset;    /* bytes from the start of A to that of B */
+} Problem;
+
+typedef struct candidate {
+    int length;
+    int width;
+    double model;
+    long long misses;   /* -1 until simulated */
+    bool correct;
+} Candidate;
+
+/* A batch of candidates shared by the worker threads */
+typedef struct batch {
+    const Problem* problem;
+    Candidate* candidates;
+    const int* todo;    /* indices into candidates */
+    int count;
+    int next;           /* next todo entry to take, updated atomically */
+    bool model;         /* estimate the candidates instead of simulating */
+} Batch;
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool parse_range(const char* arg, int* lo, int* hi) {
+    char* end;
+    *lo = *hi = (int)strtol(arg, &end, 10);
+    if (*end == '-') {
+        *hi = (int)strtol(end + 1, &end, 10);
+    }
+    return *end == '\0' && *lo >= 1 && *hi >= *lo;
+}
+
+/*
+ * tile_row - Byte range [*start, *end) of row r of a tile's footprint:
+ * A's rows i..i_end (columns j..j_end) first, then B's rows j..j_end
+ */
+static void tile_row(const Problem* p, int i, int i_end, int j, int j_end,
+                     int r, size_t* start, size_t* end) {
+    if (r < i_end - i) {
+        *start = ((size_t)(i + r) * p->M + j) * sizeof(int);
+        *end = *start + (j_end - j) * sizeof(int);
+    } else {
+        *start = p->b_offset +
+                 ((size_t)(j + r - (i_end - i)) * p->N + i) * sizeof(int);
+        *end = *start + (i_end - i) * sizeof(int);
+    }
+}
+
+/*
+ * band_fits - Whether band i..i_end's rows of A and the B lines holding
+ * its columns fit in the cache together, so that a B line the band
+ * leaves partly written is still there for the next band. count has a
+ * zeroed counter per set and is left zeroed.
+ */
+static bool band_fits(const Problem* p, int i, int i_end, int* count) {
+    size_t set_mask = ((size_t)1 << p->s) - 1;
+    bool fits = true;
+
+    for (int pass = 0; pass < 2; ++pass) {
+        for (int r = 0; r < (i_end - i) + p->M; ++r) {
+            size_t start, end;
+            tile_row(p, i, i_end, 0, p->M, r, &start, &end);
+            for (size_t line = start >> p->b; line <= (end - 1) >> p->b;
+                 ++line) {
+                if (pass == 0) {
+                    fits &= ++count[line & set_mask] <= p->E;
+                } else {
+                    count[line & set_mask] = 0;
+                }
+            }
+        }
+    }
+    return fits;
+}
+
+/*
+ * model_cost - The estimated misses of one tiling, as described at the
+ * top of the file. resident and streamed have a zeroed counter per set.
+ */
+static double model_cost(const Problem* p, int length, int width,
+                         int* resident, int* streamed) {
+    size_t block = (size_t)1 << p->b;
+    size_t set_mask = ((size_t)1 << p->s) - 1;
+    int bands = (p->N + length - 1) / length;
+    int step = (bands + MODEL_BANDS - 1) / MODEL_BANDS;
+    double cost = 0;
+    int sampled = 0;   /* rows of A in the bands looked at */
+
+    for (int band = 0; band < bands; band += step) {
+        int i = band * length;
+        int i_end = i + length < p->N ? i + length : p->N;
+        bool fits = band_fits(p, i, i_end, resident);
+        sampled += i_end - i;
+        for (int j = 0; j < p->M; j += width) {
+            int j_end = j + width < p->M ? j + width : p->M;
+            int rows = (i_end - i) + (j_end - j);
+
+            /* Count the tile's lines per set, price them, clear counts */
+            for (int pass = 0; pass < 3; ++pass) {
+                for (int r = 0; r < rows; ++r) {
+                    bool in_a = r < i_end - i;
+                    size_t start, end;
+                    tile_row(p, i, i_end, j, j_end, r, &start, &end);
+                    for (size_t line = start >> p->b;
+                         line <= (end - 1) >> p->b; ++line) {
+                        size_t set = line & set_mask;
+                        size_t lo = line << p->b;
+                        size_t hi = lo + block;
+                        size_t used = (hi < end ? hi : end) -
+                                      (lo > start ? lo : start);
+                        /* B lines stay for the whole tile, and so do A
+                           lines the next tile finishes */
+                        bool stays = !in_a || hi > end;
+                        if (pass == 0) {
+                            ++*(stays ? &resident[set] : &streamed[set]);
+                            continue;
+                        }
+                        if (pass == 2) {
+                            resident[set] = streamed[set] = 0;
+                            continue;
+                        }
+                        int live = resident[set] + (streamed[set] > 0);
+                        if (live > p->E) {
+                            cost += (double)used / sizeof(int);
+                        } else if (used == block) {
+                            cost += 1;
+                        } else if (in_a || fits) {
+                            cost += (double)used / block;
+                        } else {
+                            cost += 1;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return cost * p->N / sampled;
+}
+
+static void simulate_access(const Access* access, void* arg) {
+    csim_access(arg, access->addr, access->size, access->op);
+}
+
+/* simulate - Run the kernel with one tiling and record its misses */
+static void simulate(const Problem* p, Candidate* c, int* A, int* B) {
+    int M = p->M;
+    int N = p->N;
+    Csim* csim = csim_create(p->s, p->E, p->b, p->policy);
+    Csim_stats stats;
+
+    for (size_t k = 0; k < (size_t)M * N; ++k) {
+        A[k] = (int)k;
+        B[k] = -1;
+    }
+
+    tracehook_start(simulate_access, csim);
+    transpose_blocked(M, N, (int (*)[M])A, (int (*)[N])B, c->length,
+                      c->width);
+    tracehook_stop();
+
+    csim_stats(csim, &stats);
+    csim_destroy(csim);
+    c->misses = stats.misses;
+
+    c->correct = true;
+    for (int i = 0; i < N && c->correct; ++i) {
+        for (int j = 0; j < M; ++j) {
+            if (B[(size_t)j * N + i] != A[(size_t)i * M + j]) {
+                c->correct = false;
+                break;
+            }
+        }
+    }
+}
+
+static void* model_main(void* arg) {
+    Batch* batch = arg;
+    const Problem* p = batch->problem;
+    int* resident = calloc((size_t)1 << p->s, sizeof(*resident));
+    int* streamed = calloc((size_t)1 << p->s, sizeof(*streamed));
+    if (!resident || !streamed) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+
+    int k;
+    while ((k = __atomic_fetch_add(&batch->next, 1, __ATOMIC_RELAXED)) <
+           batch->count) {
+        Candidate* c = &batch->candidates[batch->todo[k]];
+        c->model = model_cost(p, c->length, c->width, resident, streamed);
+    }
+
+    free(streamed);
+    free(resident);
+    return NULL;
+}
+
+static void* simulate_main(void* arg) {
+    Batch* batch = arg;
+    const Problem* p = batch->problem;
+    size_t bytes = p->b_offset + (size_t)p->M * p->N * sizeof(int);
+    void* memory;
+
+    /* A page-aligned A keeps set indices the same as in test-trans */
+    if (posix_memalign(&memory, 4096, bytes)) {
+        perror("posix_memalign");
+        exit(EXIT_FAILURE);
+    }
+    int* A = memory;
+    int* B = (int*)((char*)memory + p->b_offset);
+
+    tracehook_watch(A, (size_t)p->M * p->N * sizeof(int));
+    tracehook_watch(B, (size_t)p->M * p->N * sizeof(int));
+
+    int k;
+    while ((k = __atomic_fetch_add(&batch->next, 1, __ATOMIC_RELAXED)) <
+           batch->count) {
+        simulate(p, &batch->candidates[batch->todo[k]], A, B);
+    }
+
+    tracehook_unwatch();
+    free(memory);
+    return NULL;
+}
+
+/*
+ * run_all - Simulate (or with model set, estimate) the listed candidates
+ * on up to threads threads
+ */
+static void run_all(const Problem* p, Candidate* candidates, const int* todo,
+                    int count, int threads, bool model) {
+    Batch batch = {p, candidates, todo, count, 0, model};
+    pthread_t ids[MAX_THREADS];
+
+    if (threads > count) {
+        threads = count > 0 ? count : 1;
+    }
+    for (int i = 0; i < threads; ++i) {
+        pthread_create(&ids[i], NULL, model ? model_main : simulate_main,
+                       &batch);
+    }
+    for (int i = 0; i < threads; ++i) {
+        pthread_join(ids[i], NULL);
+    }
+}
+
+/* The candidates compare_model orders indices into */
+static const Candidate* sort_base;
+
+static int compare_model(const void* a, const void* b) {
+    double x = sort_base[*(const int*)a].model;
+    double y = sort_base[*(const int*)b].model;
+    return (x > y) - (x < y);
+}
+
+static int compare_misses(const void* a, const void* b) {
+    const Candidate* x = a;
+    const Candidate* y = b;
+
+    if (x->correct != y->correct) {
+        return y->correct - x->correct;
+    }
+    if (x->misses != y->misses) {
+        return (x->misses > y->misses) - (x->misses < y->misses);
+    }
+    /* fewer, larger tiles first on ties */
+    return y->length * y->width - x->length * x->width;
+}
+
+static bool better(const Candidate* c, const Candidate* best) {
+    return c->misses >= 0 && c->correct &&
+           (!best || compare_misses(c, best) < 0);
+}
+
+static void usage(FILE* out, const char* prog) {
+    fprintf(out, "Usage: %s [-hvx] -M <M> -N <N> [-s <s> -E <E> -b <b>] "
+            "[-P <policy>]\n"
+            "       [-l <lo>-<hi>] [-w <lo>-<hi>] [-k <n>] [-j <n>]\n",
+            prog);
+    fprintf(out, "Tunes transpose_blocked() for the N x M matrix A[N][M] "
+            "on a cache of 2^s sets\nof E ways of 2^b bytes "
+            "(default 5, 1, 5, the lab's cache).\n"
+            "  -l, -w  Tile lengths (rows) and widths (columns) to try "
+            "(default 1-64)\n"
+            "  -k      Tilings to simulate in model order before the "
+            "local search\n"
+            "          (default 1/20 of them, at least 16)\n"
+            "  -x      Simulate every tiling\n"
+            "  -j      Threads (default: online CPUs)\n"
+            "  -v      Print every simulated tiling\n");
+}
+
+int main(int argc, char* argv[]) {
+    Problem p = {.s = 5, .E = 1, .b = 5, .policy = "lru"};
+    int l_lo = 1, l_hi = 64, w_lo = 1, w_hi = 64;
+    int top = 0;
+    bool exhaustive = false;
+    bool verbose = false;
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int opt;
+
+    while ((opt = getopt(argc, argv, "hvxM:N:s:E:b:P:l:w:k:j:")) != -1) {
+        switch (opt) {
+            case 'M':
+                p.M = atoi(optarg);
+                break;
+            case 'N':
+                p.N = atoi(optarg);
+                break;
+            case 's':
+                p.s = atoi(optarg);
+                break;
+            case 'E':
+                p.E = atoi(optarg);
+                break;
+            case 'b':
+                p.b = atoi(optarg);
+                break;
+            case 'P':
+                p.policy = optarg;
+                break;
+            case 'l':
+            case 'w':
+                if (!parse_range(optarg, opt == 'l' ? &l_lo : &w_lo,
+                                 opt == 'l' ? &l_hi : &w_hi)) {
+                    fprintf(stderr, "%s: bad range: %s\n", argv[0], optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'k':
+                top = atoi(optarg);
+                break;
+            case 'x':
+                exhaustive = true;
+                break;
+            case 'j':
+                threads = atoi(optarg);
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            case 'h':
+                usage(stdout, argv[0]);
+                return 0;
+            default:
+                usage(stderr, argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if (p.M < 1 || p.N < 1 || p.M > MAX_DIM || p.N > MAX_DIM) {
+        fprintf(stderr, "%s: -M and -N must be 1 to %d\n", argv[0],
+                MAX_DIM);
+        usage(stderr, argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    Csim* probe = csim_create(p.s, p.E, p.b, p.policy);
+    if (!probe) {
+        fprintf(stderr, "%s: bad cache or policy\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    csim_destroy(probe);
+    if (threads < 1) {
+        threads = 1;
+    }
+    if (threads > MAX_THREADS) {
+        threads = MAX_THREADS;
+    }
+
+    /* Tiles longer or wider than the matrix are all the same tiling */
+    l_hi = l_hi < p.N ? l_hi : p.N;
+    w_hi = w_hi < p.M ? w_hi : p.M;
+    l_lo = l_lo < l_hi ? l_lo : l_hi;
+    w_lo = w_lo < w_hi ? w_lo : w_hi;
+
+    size_t a_bytes = (size_t)p.M * p.N * sizeof(int);
+    p.b_offset = (a_bytes + B_ALIGN - 1) / B_ALIGN * B_ALIGN;
+
+    int lengths = l_hi - l_lo + 1;
+    int widths = w_hi - w_lo + 1;
+    int total = lengths * widths;
+    Candidate* candidates = malloc(total * sizeof(*candidates));
+    int* order = malloc(total * sizeof(*order));
+    if (!candidates || !order) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    double start = now();
+    for (int k = 0; k < total; ++k) {
+        Candidate* c = &candidates[k];
+        c->length = l_lo + k / widths;
+        c->width = w_lo + k % widths;
+        c->model = 0;
+        c->misses = -1;
+        c->correct = false;
+        order[k] = k;
+    }
+    if (!exhaustive) {
+        run_all(&p, candidates, order, total, threads, true);
+    }
+    double modelled = now();
+
+    if (top <= 0) {
+        top = total / 20 > 16 ? total / 20 : 16;
+    }
+    if (exhaustive || top > total) {
+        top = total;
+    }
+    sort_base = candidates;
+    qsort(order, total, sizeof(*order), compare_model);
+    run_all(&p, candidates, order, top, threads, false);
+    int simulated = top;
+
+    /* Local search around the best tiling so far */
+    const Candidate* best = NULL;
+    for (int k = 0; k < total; ++k) {
+        if (better(&candidates[k], best)) {
+            best = &candidates[k];
+        }
+    }
+    while (best && !exhaustive) {
+        int around[8];
+        int count = 0;
+        for (int dl = -1; dl <= 1; ++dl) {
+            for (int dw = -1; dw <= 1; ++dw) {
+                int l = best->length + dl - l_lo;
+                int w = best->width + dw - w_lo;
+                if (l >= 0 && l < lengths && w >= 0 && w < widths &&
+                    candidates[l * widths + w].misses < 0) {
+                    around[count++] = l * widths + w;
+                }
+            }
+        }
+        if (count == 0) {
+            break;
+        }
+        run_all(&p, candidates, around, count, threads, false);
+        simulated += count;
+
+        const Candidate* prev = best;
+        for (int k = 0; k < count; ++k) {
+            if (better(&candidates[around[k]], best)) {
+                best = &candidates[around[k]];
+            }
+        }
+        if (best == prev) {
+            break;
+        }
+    }
+    double end = now();
+
+    if (verbose) {
+        for (int k = 0; k < total; ++k) {
+            const Candidate* c = &candidates[k];
+            if (c->misses >= 0) {
+                printf("length:%d width:%d model:%.0f misses:%lld%s\n",
+                       c->length, c->width, c->model, c->misses,
+                       c->correct ? "" : " (wrong result)");
+            }
+        }
+    }
+
+    /* Simulated candidates first, best first */
+    Candidate* results = malloc(total * sizeof(*results));
+    if (!results) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    int n = 0;
+    for (int k = 0; k < total; ++k) {
+        if (candidates[k].misses >= 0) {
+            results[n++] = candidates[k];
+        }
+    }
+    qsort(results, n, sizeof(*results), compare_misses);
+
+    printf("%dx%d (M=%d, N=%d) on s=%d E=%d b=%d %s: simulated %d of %d "
+           "tilings on %d threads in %.3f s (model %.3f s)\n",
+           p.N, p.M, p.M, p.N, p.s, p.E, p.b, p.policy, simulated, total,
+           threads, end - start, modelled - start);
+    for (int k = 0; k < n && k < TOP_COUNT; ++k) {
+        printf("  length:%d width:%d misses:%lld\n", results[k].length,
+               results[k].width, results[k].misses);
+    }
+    if (n > 0 && results[0].correct) {
+        printf("best: length=%d width=%d misses=%lld\n", results[0].length,
+               results[0].width, results[0].misses);
+    }
+
+    free(results);
+    free(order);
+    free(candidates);
+    return 0;
+}
@@ -7,9 +7,12 @@
  * Function timers that estimate the running time (in seconds) of a function f.
  *    ftimer_itimer: version that uses the interval timer
  *    ftimer_gettod: version that uses gettimeofday
+ *    ftimer_clock: version that uses clock_gettime(CLOCK_MONOTONIC)
  */
+#define _POSIX_C_SOURCE 199309L
 #include <stdio.h>
 #include <sys/time.h>
+#include <time.h>
 #include "ftimer.h"
 
 /* function prototypes */
@@ -52,6 +55,25 @@ double ftimer_gettod(ftimer_test_funct f, void *argp, int n)
     return (1E-3*diff);
 }
 
+/* 
+ * ftimer_clock - Use the monotonic clock to estimate the running time
+ * of f(argp). Unlike gettimeofday it has nanosecond resolution and is
+ * not affected by NTP adjustments. Return the average of n runs.  
+ */
+double ftimer_clock(ftimer_test_funct f, void *argp, int n)
+{
+    int i;
+    struct timespec sts, ets;
+    double diff;
+
+    clock_gettime(CLOCK_MONOTONIC, &sts);
+    for (i = 0; i < n; i++) 
+	f(argp);
+    clock_gettime(CLOCK_MONOTONIC, &ets);
+    diff = (ets.tv_sec - sts.tv_sec) + 1E-9*(ets.tv_nsec - sts.tv_nsec);
+    return diff / n;
+}
+
 
 /*
  * Routines for manipulating the Unix interval timer
@@ -0,0 +1,195 @@
+/*
+ * lineprobe.c - Cache-line placement microbenchmark for mm.c
+ *
+ * Allocates many small objects through mm_malloc, interleaved with
+ * randomly sized noise allocations that fragment the heap, links the
+ * objects into a list in allocation order and then traverses it. The
+ * traversal is measured with perf_event L1D and LLC miss counters.
+ *
+ * Build it twice (see the Makefile) to compare the default placement
+ * against LINE_PLACEMENT/LINE_COLOCATE:
+ *
+ *	unix> make lineprobe
+ *	unix> ./lineprobe-base && ./lineprobe-line
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "mm.h"
+#include "memlib.h"
+
+#define LINE_BYTES 64
+
+/* One object of the traversed list; the payload is padded to size bytes */
+typedef struct obj {
+    struct obj *next;
+    int sum;
+} obj_t;
+
+/* A hardware counter that may be unavailable (e.g. inside a container) */
+typedef struct {
+    char *name;
+    int fd;
+} counter_t;
+
+static void counter_open(counter_t *c, char *name, unsigned type,
+                         unsigned long long config)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    c->name = name;
+    c->fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void counter_start(counter_t *c)
+{
+    if (c->fd >= 0) {
+        ioctl(c->fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(c->fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+static void counter_stop(counter_t *c)
+{
+    if (c->fd >= 0)
+        ioctl(c->fd, PERF_EVENT_IOC_DISABLE, 0);
+}
+
+static void counter_print(counter_t *c, int rounds, int n)
+{
+    long long count;
+
+    if (c->fd < 0 || read(c->fd, &count, sizeof(count)) != sizeof(count)) {
+        printf("%-14s n/a (perf_event_open unavailable)\n", c->name);
+        return;
+    }
+    printf("%-14s %lld (%.3f per object)\n", c->name, count / rounds,
+           (double)count / rounds / n);
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: lineprobe [-h] [-n <objs>] [-s <size>] "
+            "[-r <rounds>] [-p <noise%%>]\n");
+    fprintf(stderr, "\t-n <objs>    Number of objects (default 50000).\n");
+    fprintf(stderr, "\t-s <size>    Object size in bytes (default 48).\n");
+    fprintf(stderr, "\t-r <rounds>  Traversals to measure (default 20).\n");
+    fprintf(stderr, "\t-p <noise%%>  Chance of a noise allocation before "
+            "each object (default 50).\n");
+}
+
+int main(int argc, char **argv)
+{
+    int n = 50000, size = 48, rounds = 20, noise = 50;
+    int i, r, c, straddles = 0, lines = 0, nnoise = 0;
+    char **noisep;
+    obj_t **objs, *p;
+    long sum = 0;
+    double secs;
+    struct timespec t0, t1;
+    counter_t counters[2];
+
+    while ((c = getopt(argc, argv, "hn:s:r:p:")) != -1) {
+        switch (c) {
+        case 'n': n = atoi(optarg); break;
+        case 's': size = atoi(optarg); break;
+        case 'r': rounds = atoi(optarg); break;
+        case 'p': noise = atoi(optarg); break;
+        case 'h': usage(); exit(0);
+        default: usage(); exit(1);
+        }
+    }
+    if (n <= 0 || rounds <= 0 || size < (int)sizeof(obj_t)) {
+        usage();
+        exit(1);
+    }
+
+    objs = malloc(n * sizeof(*objs));
+    noisep = malloc(n * sizeof(*noisep));
+    if (!objs || !noisep) {
+        fprintf(stderr, "lineprobe: out of memory\n");
+        exit(1);
+    }
+
+    mem_init();
+    if (mm_init() < 0) {
+        fprintf(stderr, "lineprobe: mm_init failed\n");
+        exit(1);
+    }
+
+    /* Interleave objects with noise, then free half the noise */
+    srand(15213);
+    for (i = 0; i < n; i++) {
+        if (rand() % 100 < noise) {
+            if ((noisep[nnoise++] = mm_malloc(1 + rand() % 200)) == NULL)
+                break;
+        }
+        if ((objs[i] = mm_malloc(size)) == NULL)
+            break;
+        memset(objs[i], 0, size);
+        objs[i]->sum = i;
+    }
+    if (i < n) {
+        fprintf(stderr, "lineprobe: heap exhausted after %d objects\n", i);
+        exit(1);
+    }
+    for (i = 0; i < nnoise; i += 2)
+        mm_free(noisep[i]);
+
+    for (i = 0; i < n; i++) {
+        unsigned long lo = (unsigned long)objs[i];
+        unsigned long hi = lo + size - 1;
+
+        objs[i]->next = (i + 1 < n) ? objs[i + 1] : NULL;
+        straddles += (lo / LINE_BYTES) != (hi / LINE_BYTES);
+        lines += hi / LINE_BYTES - lo / LINE_BYTES + 1;
+    }
+
+    counter_open(&counters[0], "L1D misses", PERF_TYPE_HW_CACHE,
+                 PERF_COUNT_HW_CACHE_L1D |
+                 (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                 (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    counter_open(&counters[1], "LLC misses", PERF_TYPE_HARDWARE,
+                 PERF_COUNT_HW_CACHE_MISSES);
+
+    /* Touch the first and the last word of every object on each pass */
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    counter_start(&counters[0]);
+    counter_start(&counters[1]);
+    for (r = 0; r < rounds; r++) {
+        for (p = objs[0]; p != NULL; p = p->next)
+            sum += p->sum + ((char *)p)[size - 1];
+    }
+    counter_stop(&counters[0]);
+    counter_stop(&counters[1]);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+    printf("objects        %d x %d bytes (%d noise)\n", n, size, nnoise);
+    printf("straddling     %d (%.1f%%)\n", straddles, 100.0 * straddles / n);
+    printf("lines/object   %.3f\n", (double)lines / n);
+    printf("heap size      %lu bytes\n", (unsigned long)mem_heapsize());
+    counter_print(&counters[0], rounds, n);
+    counter_print(&counters[1], rounds, n);
+    printf("ns/object      %.2f (checksum %ld)\n",
+           secs * 1e9 / rounds / n, sum);
+
+    mem_deinit();
+    free(objs);
+    free(noisep);
+    return 0;
+}
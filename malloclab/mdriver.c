@@ -124,6 +124,12 @@ static void eval_libc_speed(void *ptr);
 static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges);
 static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges);
 static void eval_mm_speed(void *ptr);
+static void eval_mm_traces(char **tracefiles, int num_tracefiles,
+			   stats_t *mm_stats, range_t **ranges);
+static double compute_perfindex(int n, stats_t *stats,
+				double *avg_util, double *avg_throughput);
+static void sweep_fit_probes(char *klist, char **tracefiles,
+			     int num_tracefiles, range_t **ranges);
 
 /* Various helper routines */
 static void printresults(int n, stats_t *stats);
@@ -146,23 +152,28 @@ int main(int argc, char **argv)
     stats_t *libc_stats = NULL;/* libc stats for each trace */
     stats_t *mm_stats = NULL;  /* mm (i.e. student) stats for each trace */
     speed_t speed_params;      /* input parameters to the xx_speed routines */ 
+    char *fit_sweep = NULL;    /* comma-separated probe budgets (-K) */
 
     int team_check = 1;  /* If set, check team structure (reset by -a) */
     int run_libc = 0;    /* If set, run libc malloc (set by -l) */
     int autograder = 0;  /* If set, emit summary info for autograder (-g) */
+    int parseable = 0;   /* If set, emit per-trace results for scripts (-p) */
 
     /* temporaries used to compute the performance index */
-    double secs, ops, util, avg_mm_util, avg_mm_throughput, p1, p2, perfindex;
+    double avg_mm_util, avg_mm_throughput, perfindex;
     int numcorrect;
     
     /* 
      * Read and interpret the command line arguments 
      */
-    while ((c = getopt(argc, argv, "f:t:hvVgal")) != EOF) {
+    while ((c = getopt(argc, argv, "f:t:K:hvVgalp")) != EOF) {
         switch (c) {
 	case 'g': /* Generate summary info for the autograder */
 	    autograder = 1;
 	    break;
+	case 'p': /* Print per-trace results in a form scripts can parse */
+	    parseable = 1;
+	    break;
         case 'f': /* Use one specific trace file only (relative to curr dir) */
             num_tracefiles = 1;
             if ((tracefiles = realloc(tracefiles, 2*sizeof(char *))) == NULL)
@@ -181,6 +192,9 @@ int main(int argc, char **argv)
         case 'a': /* Don't check team structure */
             team_check = 0;
             break;
+        case 'K': /* Sweep the mm.c free-list probe budget */
+            fit_sweep = optarg;
+            break;
         case 'l': /* Run libc malloc */
             run_libc = 1;
             break;
@@ -287,26 +301,15 @@ int main(int argc, char **argv)
     /* Initialize the simulated memory system in memlib.c */
     mem_init(); 
 
-    /* Evaluate student's mm malloc package using the K-best scheme */
-    for (i=0; i < num_tracefiles; i++) {
-	trace = read_trace(tracedir, tracefiles[i]);
-	mm_stats[i].ops = trace->num_ops;
-	if (verbose > 1)
-	    printf("Checking mm_malloc for correctness, ");
-	mm_stats[i].valid = eval_mm_valid(trace, i, &ranges);
-	if (mm_stats[i].valid) {
-	    if (verbose > 1)
-		printf("efficiency, ");
-	    mm_stats[i].util = eval_mm_util(trace, i, &ranges);
-	    speed_params.trace = trace;
-	    speed_params.ranges = ranges;
-	    if (verbose > 1)
-		printf("and performance.\n");
-	    mm_stats[i].secs = fsecs(eval_mm_speed, &speed_params);
-	}
-	free_trace(trace);
+    /* Optionally trade utilization for throughput over a range of budgets */
+    if (fit_sweep) {
+	sweep_fit_probes(fit_sweep, tracefiles, num_tracefiles, &ranges);
+	exit(errors ? 1 : 0);
     }
 
+    /* Evaluate student's mm malloc package using the K-best scheme */
+    eval_mm_traces(tracefiles, num_tracefiles, mm_stats, &ranges);
+
     /* Display the mm results in a compact table */
     if (verbose) {
 	printf("\nResults for mm malloc:\n");
@@ -317,38 +320,21 @@ int main(int argc, char **argv)
     /* 
      * Accumulate the aggregate statistics for the student's mm package 
      */
-    secs = 0;
-    ops = 0;
-    util = 0;
     numcorrect = 0;
     for (i=0; i < num_tracefiles; i++) {
-	secs += mm_stats[i].secs;
-	ops += mm_stats[i].ops;
-	util += mm_stats[i].util;
 	if (mm_stats[i].valid)
 	    numcorrect++;
     }
-    avg_mm_util = util/num_tracefiles;
 
     /* 
      * Compute and print the performance index 
      */
     if (errors == 0) {
-	avg_mm_throughput = ops/secs;
-
-	p1 = UTIL_WEIGHT * avg_mm_util;
-	if (avg_mm_throughput > AVG_LIBC_THRUPUT) {
-	    p2 = (double)(1.0 - UTIL_WEIGHT);
-	} 
-	else {
-	    p2 = ((double) (1.0 - UTIL_WEIGHT)) * 
-		(avg_mm_throughput/AVG_LIBC_THRUPUT);
-	}
-	
-	perfindex = (p1 + p2)*100.0;
+	perfindex = compute_perfindex(num_tracefiles, mm_stats,
+				      &avg_mm_util, &avg_mm_throughput);
 	printf("Perf index = %.0f (util) + %.0f (thru) = %.0f/100\n",
-	       p1*100, 
-	       p2*100, 
+	       UTIL_WEIGHT * avg_mm_util * 100, 
+	       perfindex - UTIL_WEIGHT * avg_mm_util * 100, 
 	       perfindex);
 	
     }
@@ -357,6 +343,14 @@ int main(int argc, char **argv)
 	printf("Terminated with %d errors\n", errors);
     }
 
+    if (parseable) {
+	for (i=0; i < num_tracefiles; i++) {
+	    printf("result:%s valid:%d util:%.6f ops:%.0f secs:%.9f\n",
+		   tracefiles[i], mm_stats[i].valid, mm_stats[i].util,
+		   mm_stats[i].ops, mm_stats[i].secs);
+	}
+    }
+
     if (autograder) {
 	printf("correct:%d\n", numcorrect);
 	printf("perfidx:%.0f\n", perfindex);
@@ -825,6 +819,124 @@ static void eval_mm_speed(void *ptr)
         }
 }
 
+/*
+ * eval_mm_traces - Check, measure the utilization of, and time the mm
+ *     malloc package on each of the tracefiles.
+ */
+static void eval_mm_traces(char **tracefiles, int num_tracefiles,
+			   stats_t *mm_stats, range_t **ranges)
+{
+    int i;
+    trace_t *trace;
+    speed_t speed_params;
+
+    for (i=0; i < num_tracefiles; i++) {
+	trace = read_trace(tracedir, tracefiles[i]);
+	mm_stats[i].ops = trace->num_ops;
+	if (verbose > 1)
+	    printf("Checking mm_malloc for correctness, ");
+	mm_stats[i].valid = eval_mm_valid(trace, i, ranges);
+	if (mm_stats[i].valid) {
+	    if (verbose > 1)
+		printf("efficiency, ");
+	    mm_stats[i].util = eval_mm_util(trace, i, ranges);
+	    speed_params.trace = trace;
+	    speed_params.ranges = *ranges;
+	    if (verbose > 1)
+		printf("and performance.\n");
+	    mm_stats[i].secs = fsecs(eval_mm_speed, &speed_params);
+	}
+	free_trace(trace);
+    }
+}
+
+/*
+ * sweep_fit_probes - Run the whole trace set once per probe budget in
+ *     klist (e.g. "0,1,2,4,8") and print utilization against throughput.
+ *     Points that no other budget beats on both axes are marked as
+ *     Pareto-optimal.
+ */
+static void sweep_fit_probes(char *klist, char **tracefiles,
+			     int num_tracefiles, range_t **ranges)
+{
+    int i, j, n = 0;
+    int budgets[MAXLINE];
+    double util[MAXLINE], thru[MAXLINE], perf[MAXLINE];
+    char *tok, *list;
+    stats_t *stats;
+
+    if ((list = strdup(klist)) == NULL)
+	unix_error("strdup failed in sweep_fit_probes");
+    for (tok = strtok(list, ","); tok != NULL && n < MAXLINE; 
+	 tok = strtok(NULL, ","))
+	budgets[n++] = atoi(tok);
+    free(list);
+
+    if ((stats = (stats_t *)calloc(num_tracefiles, sizeof(stats_t))) == NULL)
+	unix_error("stats calloc in sweep_fit_probes failed");
+
+    for (i = 0; i < n; i++) {
+	if (verbose > 1)
+	    printf("\nTesting mm malloc with fit probe budget %d\n", budgets[i]);
+	mm_set_fit_probes(budgets[i]);
+	eval_mm_traces(tracefiles, num_tracefiles, stats, ranges);
+	if (errors) {
+	    printf("Terminated with %d errors at fit probe budget %d\n", 
+		   errors, budgets[i]);
+	    free(stats);
+	    return;
+	}
+	perf[i] = compute_perfindex(num_tracefiles, stats, &util[i], &thru[i]);
+	if (verbose) {
+	    printf("\nResults for mm malloc, fit probe budget %d:\n", budgets[i]);
+	    printresults(num_tracefiles, stats);
+	}
+    }
+    free(stats);
+
+    printf("\nFit probe sweep (K=0 is unbounded best fit):\n");
+    printf("%6s%7s%10s%7s%8s\n", "K", "util", "Kops", "perf", "pareto");
+    for (i = 0; i < n; i++) {
+	int dominated = 0;
+	for (j = 0; j < n; j++) {
+	    if (util[j] >= util[i] && thru[j] >= thru[i] &&
+		(util[j] > util[i] || thru[j] > thru[i]))
+		dominated = 1;
+	}
+	printf("%6d%6.1f%%%10.0f%7.0f%8s\n", budgets[i], util[i] * 100.0, 
+	       thru[i] / 1e3, perf[i], dominated ? "" : "*");
+    }
+}
+
+/*
+ * compute_perfindex - Combine the average utilization and the average
+ *     throughput (capped at AVG_LIBC_THRUPUT) into the performance index.
+ */
+static double compute_perfindex(int n, stats_t *stats,
+				double *avg_util, double *avg_throughput)
+{
+    int i;
+    double secs = 0, ops = 0, util = 0, p1, p2;
+
+    for (i=0; i < n; i++) {
+	secs += stats[i].secs;
+	ops += stats[i].ops;
+	util += stats[i].util;
+    }
+    *avg_util = util/n;
+    *avg_throughput = ops/secs;
+
+    p1 = UTIL_WEIGHT * *avg_util;
+    if (*avg_throughput > AVG_LIBC_THRUPUT) {
+	p2 = (double)(1.0 - UTIL_WEIGHT);
+    } 
+    else {
+	p2 = ((double) (1.0 - UTIL_WEIGHT)) * 
+	    (*avg_throughput/AVG_LIBC_THRUPUT);
+    }
+    return (p1 + p2)*100.0;
+}
+
 /*
  * eval_libc_valid - We run this function to make sure that the
  *    libc malloc can run to completion on the set of traces.
@@ -1004,13 +1116,15 @@ void malloc_error(int tracenum, int opnum, char *msg)
  */
 static void usage(void) 
 {
-    fprintf(stderr, "Usage: mdriver [-hvVal] [-f <file>] [-t <dir>]\n");
+    fprintf(stderr, "Usage: mdriver [-hvValp] [-f <file>] [-t <dir>] [-K <k,...>]\n");
     fprintf(stderr, "Options\n");
     fprintf(stderr, "\t-a         Don't check the team structure.\n");
     fprintf(stderr, "\t-f <file>  Use <file> as the trace file.\n");
     fprintf(stderr, "\t-g         Generate summary info for autograder.\n");
     fprintf(stderr, "\t-h         Print this message.\n");
+    fprintf(stderr, "\t-K <k,...> Sweep mm.c fit probe budgets (0 = unbounded).\n");
     fprintf(stderr, "\t-l         Run libc malloc as well.\n");
+    fprintf(stderr, "\t-p         Print per-trace results for scripts.\n");
     fprintf(stderr, "\t-t <dir>   Directory to find default traces.\n");
     fprintf(stderr, "\t-v         Print per-trace performance breakdowns.\n");
     fprintf(stderr, "\t-V         Print additional debug info.\n");
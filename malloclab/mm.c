@@ -6,7 +6,9 @@
 #include <string.h>
 #include <unistd.h>
 
+#include "config.h"
 #include "memlib.h"
+#include "mmprof.h"
 
 /*********************************************************
  * NOTE TO STUDENTS: Before you do anything else, please
@@ -33,6 +35,57 @@ team_t team = {
 #define WSIZE 4
 #define PAGE_SIZE 4096
 
+/*
+ * Opt-in cache-line aware placement. With LINE_PLACEMENT set, a payload
+ * of at most LINE_SIZE bytes is never placed across a line boundary.
+ * LINE_COLOCATE additionally tries the free block right after the last
+ * small allocation first, so objects allocated together share lines.
+ */
+#ifndef LINE_PLACEMENT
+#define LINE_PLACEMENT 0
+#endif
+
+#ifndef LINE_COLOCATE
+#define LINE_COLOCATE 0
+#endif
+
+#define LINE_SIZE 64
+
+/*
+ * Experimental headerless layout. With SEGREGATED_PAGES set, requests of
+ * up to SMALL_MAX bytes are served from pages that each hold a single
+ * size class. The size lives in a descriptor at the start of the page,
+ * so these objects carry no header and no footer. A page is the payload
+ * of an ordinary PAGE_SIZE block aligned to PAGE_SIZE, and a bitmap in
+ * the first heap page tells mm_free which pages hold small objects.
+ */
+#ifndef SEGREGATED_PAGES
+#define SEGREGATED_PAGES 0
+#endif
+
+#define SMALL_MAX 64
+#define SMALL_CLASSES (SMALL_MAX / ALIGNMENT)
+#define MAX_HEAP_PAGES (MAX_HEAP / PAGE_SIZE + 1)
+#define PAGE_MAP_SIZE ((MAX_HEAP_PAGES + 63) / 64 * 8)
+
+/*
+ * Opt-in sampling heap profiler (see mmprof.c). The hooks compile away
+ * unless HEAP_PROFILE is set.
+ */
+#ifndef HEAP_PROFILE
+#define HEAP_PROFILE 0
+#endif
+
+#if HEAP_PROFILE
+#define PROF_MALLOC(ptr, size) prof_malloc(ptr, size)
+#define PROF_FREE(ptr) prof_free(ptr)
+#define PROF_REALLOC(ptr, size) (prof_free(ptr), prof_malloc(ptr, size))
+#else
+#define PROF_MALLOC(ptr, size)
+#define PROF_FREE(ptr)
+#define PROF_REALLOC(ptr, size)
+#endif
+
 #define LISTS_COUNT 16
 #define MAX_LIST_INDEX (LISTS_COUNT - 1)
 
@@ -69,6 +122,35 @@ team_t team = {
 
 void** lists = NULL;
 
+/*
+ * Probe budget for the free lists (see mm_set_fit_probes). 0 keeps every
+ * list fully sorted and find_fit returns the first (best) fit.
+ */
+static int fit_probes = 0;
+
+#if LINE_PLACEMENT && LINE_COLOCATE
+static void* last_small = NULL;
+#endif
+
+#if SEGREGATED_PAGES
+/* Descriptor at the start of every small-object page */
+typedef struct page {
+    unsigned int obj_size;  /* size class of every object in the page */
+    unsigned int used;      /* objects currently handed out */
+    unsigned int bump;      /* offset of the first never-used slot */
+    void* free_objs;        /* freed objects, linked through their first word */
+    struct page* prev;      /* pages of the same class with free slots */
+    struct page* next;
+} page_t;
+
+#define PAGE_HDR_SIZE ((int)((sizeof(page_t) + 7) & ~7))
+#define PAGE_END (PAGE_SIZE - WSIZE) /* the next block's header follows */
+
+static page_t** page_lists = NULL;
+static unsigned char* page_map = NULL;
+static unsigned long page_map_base = 0;
+#endif
+
 static inline int log2_ceil(unsigned int x) {
     if (x <= 1) {
         return 0;
@@ -101,7 +183,12 @@ static inline void insert_block(void* block, int block_size) {
     void* curr = lists[index];
     void* prev = NULL;
 
+    int probes = 0;
+
     while (curr != NULL && GET_SIZE(curr) < block_size) {
+        if (fit_probes && ++probes > fit_probes) {
+            break;
+        }
         prev = curr;
         curr = GET_NEXT_BLK(curr);
     }
@@ -138,22 +225,83 @@ static inline void delete_block(void* block) {
     }
 }
 
+/*
+ * find_fit - With an unbounded budget the lists are sorted, so the first
+ *     fit is the best fit. With a budget of K, lists are only sorted
+ *     within the first K entries; inspect K blocks, keep the tightest fit
+ *     and, if nothing fit yet, settle for the next fit found.
+ */
 static inline void* find_fit(int malloc_block_size) {
     int index = get_index(malloc_block_size);
+    void* best = NULL;
+    int best_size = 0;
+    int probes = 0;
 
     for (; index <= MAX_LIST_INDEX; ++index) {
         void* curr = lists[index];
         while (curr) {
-            if (GET_SIZE(curr) >= malloc_block_size) {
+            int curr_size = GET_SIZE(curr);
+            if (curr_size >= malloc_block_size) {
+                if (!fit_probes || curr_size == malloc_block_size) {
+                    return curr;
+                }
+                if (!best || curr_size < best_size) {
+                    best = curr;
+                    best_size = curr_size;
+                }
+            }
+
+            if (fit_probes && ++probes >= fit_probes && best) {
+                return best;
+            }
+            curr = GET_NEXT_BLK(curr);
+        }
+    }
+
+    return best;
+}
+
+#if LINE_PLACEMENT || SEGREGATED_PAGES
+/*
+ * boundary_gap - bytes to skip at the front of a free block so that a
+ *     payload of size bytes does not cross a multiple of boundary, or -1
+ *     if it won't fit. A nonzero gap must be large enough to stand alone
+ *     as a free block.
+ */
+static inline int boundary_gap(void* block, int malloc_block_size, int size, int boundary) {
+    int offset = (int)((unsigned long)GET_PAYLOAD(block) % boundary);
+    int gap = 0;
+
+    if (offset + size > boundary) {
+        gap = boundary - offset;
+        if (gap < 4 * WSIZE) {
+            gap += boundary;
+        }
+    }
+
+    if (gap + malloc_block_size > (int)GET_SIZE(block)) {
+        return -1;
+    }
+    return gap;
+}
+
+static inline void* find_boundary_fit(int malloc_block_size, int size, int boundary, int* gap) {
+    int index = get_index(malloc_block_size);
+
+    for (; index <= MAX_LIST_INDEX; ++index) {
+        void* curr = lists[index];
+        while (curr) {
+            *gap = boundary_gap(curr, malloc_block_size, size, boundary);
+            if (*gap >= 0) {
                 return curr;
-            } else {
-                curr = GET_NEXT_BLK(curr);
             }
+            curr = GET_NEXT_BLK(curr);
         }
     }
 
     return NULL;
 }
+#endif
 
 static inline void set_next_physical_prev_flag(void* block, int offset, int prev_flag) {
     void* next_physical = OFFSET(block, offset);
@@ -254,6 +402,203 @@ static inline void* extend_heap(int extend_size) {
 }
 
 
+#if LINE_PLACEMENT || SEGREGATED_PAGES
+/*
+ * allocate_block_at - like allocate_block, but first splits gap bytes
+ *     off the front of the free block and returns them to the lists.
+ */
+static inline void* allocate_block_at(void* block, int gap, int malloc_block_size) {
+    delete_block(block);
+
+    if (gap > 0) {
+        int block_size = GET_SIZE(block);
+        int prev_flag = GET_PREV_FLAG(block);
+
+        init_block(block, gap, prev_flag, FREE);
+        insert_block(block, gap);
+
+        block = OFFSET(block, gap);
+        init_block(block, block_size - gap, FREE, ALLOC);
+    }
+
+    place_block(block, malloc_block_size);
+    return GET_PAYLOAD(block);
+}
+
+/*
+ * malloc_within - allocate a block whose first size payload bytes do not
+ *     cross a multiple of boundary, trying the free block hint first.
+ */
+static inline void* malloc_within(int malloc_block_size, int size, int boundary, void* hint) {
+    int gap = -1;
+    void* block = NULL;
+
+    if (hint && GET_FLAG(hint) == FREE) {
+        gap = boundary_gap(hint, malloc_block_size, size, boundary);
+        block = gap >= 0 ? hint : NULL;
+    }
+
+    if (!block) {
+        block = find_boundary_fit(malloc_block_size, size, boundary, &gap);
+    }
+
+    if (!block) {
+        // the largest gap boundary_gap can ask for is boundary + ALIGNMENT
+        int extend_size = MAX(malloc_block_size + boundary + 4 * WSIZE, PAGE_SIZE);
+        block = extend_heap(extend_size);
+        if (!block) {
+            return NULL;
+        }
+        gap = boundary_gap(block, malloc_block_size, size, boundary);
+    }
+
+    return allocate_block_at(block, gap, malloc_block_size);
+}
+#endif
+
+#if LINE_PLACEMENT
+static inline void* malloc_small(int malloc_block_size, int size) {
+    void* hint = NULL;
+
+#if LINE_COLOCATE
+    if (last_small) {
+        hint = OFFSET(last_small, GET_SIZE(last_small));
+    }
+#endif
+
+    void* payload = malloc_within(malloc_block_size, size, LINE_SIZE, hint);
+#if LINE_COLOCATE
+    if (payload) {
+        last_small = GET_BLOCK(payload);
+    }
+#endif
+    return payload;
+}
+#endif
+
+/*
+ * release_block - return an allocated block to the free lists.
+ */
+static inline void release_block(void* block) {
+    int size = GET_SIZE(block);
+    int prev_flag = GET_PREV_FLAG(block);
+
+#if LINE_PLACEMENT && LINE_COLOCATE
+    if (block == last_small) {
+        last_small = NULL;
+    }
+#endif
+
+    init_block(block, size, prev_flag, FREE);
+    set_next_physical_prev_flag(block, size, FREE);
+
+    coalesce(block);
+}
+
+#if SEGREGATED_PAGES
+static inline page_t* get_page(void* ptr) {
+    return (page_t*)((unsigned long)ptr & ~(unsigned long)(PAGE_SIZE - 1));
+}
+
+static inline int is_small_ptr(void* ptr) {
+    unsigned long index = (unsigned long)ptr / PAGE_SIZE - page_map_base;
+    return (page_map[index >> 3] >> (index & 7)) & 1;
+}
+
+static inline void set_page_map(page_t* page, int flag) {
+    unsigned long index = (unsigned long)page / PAGE_SIZE - page_map_base;
+    if (flag) {
+        page_map[index >> 3] |= 1 << (index & 7);
+    } else {
+        page_map[index >> 3] &= ~(1 << (index & 7));
+    }
+}
+
+static inline int page_full(page_t* page) {
+    return !page->free_objs && (int)(page->bump + page->obj_size) > PAGE_END;
+}
+
+static inline void push_page(int class, page_t* page) {
+    page->prev = NULL;
+    page->next = page_lists[class];
+    if (page->next) {
+        page->next->prev = page;
+    }
+    page_lists[class] = page;
+}
+
+static inline void unlink_page(int class, page_t* page) {
+    if (page->prev) {
+        page->prev->next = page->next;
+    } else {
+        page_lists[class] = page->next;
+    }
+    if (page->next) {
+        page->next->prev = page->prev;
+    }
+}
+
+/*
+ * page_malloc - take a slot from a page of the right class, carving a
+ *     new page-aligned page out of the heap when every page is full.
+ */
+static inline void* page_malloc(size_t size) {
+    int obj_size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    int class = obj_size / ALIGNMENT - 1;
+    page_t* page = page_lists[class];
+
+    if (!page) {
+        page = malloc_within(PAGE_SIZE, PAGE_SIZE - WSIZE, PAGE_SIZE, NULL);
+        if (!page) {
+            return NULL;
+        }
+        page->obj_size = obj_size;
+        page->used = 0;
+        page->bump = PAGE_HDR_SIZE;
+        page->free_objs = NULL;
+        push_page(class, page);
+        set_page_map(page, 1);
+    }
+
+    void* obj;
+    if (page->free_objs) {
+        obj = page->free_objs;
+        page->free_objs = *(void**)obj;
+    } else {
+        obj = OFFSET(page, page->bump);
+        page->bump += obj_size;
+    }
+    page->used++;
+
+    if (page_full(page)) {
+        unlink_page(class, page);
+    }
+    return obj;
+}
+
+/*
+ * page_free - put a slot back; an empty page goes back to the heap
+ *     unless it is the last page of its class with free slots.
+ */
+static inline void page_free(void* ptr) {
+    page_t* page = get_page(ptr);
+    int class = page->obj_size / ALIGNMENT - 1;
+
+    if (page_full(page)) {
+        push_page(class, page);
+    }
+    *(void**)ptr = page->free_objs;
+    page->free_objs = ptr;
+    page->used--;
+
+    if (page->used == 0 && (page->prev || page->next)) {
+        unlink_page(class, page);
+        set_page_map(page, 0);
+        release_block(GET_BLOCK(page));
+    }
+}
+#endif
+
 /*
  * mm_init - initialize the malloc package.
  */
@@ -264,6 +609,15 @@ int mm_init(void) {
     }
 
     int lists_size = LISTS_COUNT * sizeof(void*);
+
+#if SEGREGATED_PAGES
+    // the page lists and the page map share the first page with lists
+    page_lists = (page_t**)OFFSET(lists, lists_size);
+    page_map = (unsigned char*)OFFSET(page_lists, SMALL_CLASSES * sizeof(void*));
+    page_map_base = (unsigned long)mem_heap_lo() / PAGE_SIZE;
+    lists_size += SMALL_CLASSES * sizeof(void*) + PAGE_MAP_SIZE;
+#endif
+
     memset(lists, 0, lists_size);
 
     int padding_size = WSIZE;
@@ -282,20 +636,41 @@ int mm_init(void) {
     init_block(block, block_size, ALLOC, FREE);
     insert_block(block, block_size);
 
+#if LINE_PLACEMENT && LINE_COLOCATE
+    last_small = NULL;
+#endif
+
+#if HEAP_PROFILE
+    prof_reset_inuse();
+#endif
+
     return 0;
 }
 
 /*
- * mm_malloc - Allocate a block by incrementing the brk pointer.
- *     Always allocate a block whose size is a multiple of the alignment.
+ * malloc_payload - Place a payload of size bytes in a fitting free
+ *     block, extending the heap only if none fits. Returns NULL if the
+ *     heap cannot grow. mm_malloc is this plus the profiler hook.
  */
-void* mm_malloc(size_t size) {
+static inline void* malloc_payload(size_t size) {
+#if SEGREGATED_PAGES
+    if (size > 0 && size <= SMALL_MAX) {
+        return page_malloc(size);
+    }
+#endif
+
     int malloc_payload_size = ALIGN_PAYLOAD(size);
     if (malloc_payload_size < 3 * WSIZE) {
         malloc_payload_size = 3 * WSIZE;
     }
     int malloc_block_size = malloc_payload_size + WSIZE;
 
+#if LINE_PLACEMENT
+    if (size > 0 && size <= LINE_SIZE) {
+        return malloc_small(malloc_block_size, size);
+    }
+#endif
+
     void* block = find_fit(malloc_block_size);
     if (block) {
         return allocate_block(block, malloc_block_size);
@@ -311,18 +686,39 @@ void* mm_malloc(size_t size) {
     }
 }
 
+/*
+ * mm_set_fit_probes - Bound the free-list walks in insert_block and
+ *     find_fit to probes blocks (0 = unbounded best fit). Set it before
+ *     mm_init so the lists are built under the same budget.
+ */
+void mm_set_fit_probes(int probes) {
+    fit_probes = probes > 0 ? probes : 0;
+}
+
+/*
+ * mm_malloc - Allocate a payload of at least size bytes. With
+ *     HEAP_PROFILE, the request is then offered to the sampling profiler.
+ */
+void* mm_malloc(size_t size) {
+    void* payload = malloc_payload(size);
+    PROF_MALLOC(payload, size);
+    return payload;
+}
+
 /*
  * mm_free - Freeing a block does nothing.
  */
 void mm_free(void* ptr) {
-    void* block = GET_BLOCK(ptr);
-    int size = GET_SIZE(block);
-    int prev_flag = GET_PREV_FLAG(block);
+    PROF_FREE(ptr);
 
-    init_block(block, size, prev_flag, FREE);
-    set_next_physical_prev_flag(block, size, FREE);
+#if SEGREGATED_PAGES
+    if (is_small_ptr(ptr)) {
+        page_free(ptr);
+        return;
+    }
+#endif
 
-    coalesce(block);
+    release_block(GET_BLOCK(ptr));
 }
 
 /*
@@ -338,6 +734,23 @@ void* mm_realloc(void* ptr, size_t size) {
         return NULL;
     }
 
+#if SEGREGATED_PAGES
+    if (is_small_ptr(ptr)) {
+        int obj_size = get_page(ptr)->obj_size;
+        if ((int)size <= obj_size) {
+            PROF_REALLOC(ptr, size);
+            return ptr;
+        }
+
+        void* new_payload = mm_malloc(size);
+        if (new_payload) {
+            memcpy(new_payload, ptr, obj_size);
+            mm_free(ptr);
+        }
+        return new_payload;
+    }
+#endif
+
     void* old_payload = ptr;
     void* old_block = GET_BLOCK(old_payload);
     int old_block_size = GET_SIZE(old_block);
@@ -350,6 +763,7 @@ void* mm_realloc(void* ptr, size_t size) {
     
     if (old_block_size >= new_block_size) {
         place_block(old_block, new_block_size);
+        PROF_REALLOC(old_payload, size);
         return old_payload;
 
     } else {
@@ -365,6 +779,7 @@ void* mm_realloc(void* ptr, size_t size) {
             init_block(old_block, coalesced_size, prev_flag, ALLOC);
 
             place_block(old_block, new_block_size);
+            PROF_REALLOC(old_payload, size);
             return old_payload;
         }
 
@@ -391,6 +806,7 @@ void* mm_realloc(void* ptr, size_t size) {
                 init_block(old_block, coalesced_size, prev_flag, ALLOC);
 
                 place_block(old_block, new_block_size);
+                PROF_REALLOC(old_payload, size);
                 return old_payload;
             }
         }
@@ -0,0 +1,204 @@
+#!/usr/bin/env python3
+#
+# mmbench.py - Repeatable benchmark of mm.c with regression gating.
+#
+#     Runs mdriver repeatedly over a fixed trace corpus, pinned to one
+#     CPU, and reports per-trace and overall throughput and utilization
+#     with 95% confidence intervals. Results are written as JSON and can
+#     be compared against a stored baseline; a throughput or utilization
+#     drop beyond the threshold makes the script exit with status 1.
+#
+#     unix> make
+#     unix> ./mmbench.py --save-baseline bench-baseline.json
+#     ... edit mm.c, make ...
+#     unix> ./mmbench.py --baseline bench-baseline.json
+#
+import json
+import math
+import optparse
+import os
+import platform
+import re
+import subprocess
+import sys
+import time
+
+# Two-sided 95% Student t quantiles, indexed by degrees of freedom
+T95 = [0, 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262,
+       2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101,
+       2.093, 2.086, 2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052,
+       2.048, 2.045, 2.042]
+
+RESULT_RE = re.compile(r"^result:(\S+) valid:(\d+) util:([\d.]+) "
+                       r"ops:([\d.]+) secs:([\d.eE+-]+)$")
+
+#
+# summarize - mean and 95% confidence half-width of a list of samples
+#
+def summarize(samples):
+    n = len(samples)
+    mean = sum(samples) / n
+    if n < 2:
+        return {"mean": mean, "ci95": 0.0, "samples": samples}
+    var = sum((x - mean) ** 2 for x in samples) / (n - 1)
+    t = T95[n - 1] if n - 1 < len(T95) else 1.960
+    return {"mean": mean, "ci95": t * math.sqrt(var / n), "samples": samples}
+
+#
+# run_mdriver - run mdriver once on the given CPU and parse its results
+#
+def run_mdriver(mdriver, tracedir, cpu):
+    def pin():
+        if cpu is not None:
+            os.sched_setaffinity(0, {cpu})
+
+    p = subprocess.run([mdriver, "-a", "-p", "-t", tracedir],
+                       stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                       text=True, preexec_fn=pin)
+    results = {}
+    for line in p.stdout.splitlines():
+        m = RESULT_RE.match(line.strip())
+        if m:
+            results[m.group(1)] = {"valid": int(m.group(2)),
+                                   "util": float(m.group(3)),
+                                   "ops": float(m.group(4)),
+                                   "secs": float(m.group(5))}
+    if p.returncode != 0 or not results:
+        sys.exit("mmbench: %s failed:\n%s" % (mdriver, p.stdout))
+    bad = [t for t, r in results.items() if not r["valid"]]
+    if bad:
+        sys.exit("mmbench: mm.c is incorrect on %s" % ", ".join(bad))
+    return results
+
+#
+# benchmark - collect per-trace and overall samples over several runs
+#
+def benchmark(mdriver, tracedir, runs, warmup, cpu):
+    for _ in range(warmup):
+        run_mdriver(mdriver, tracedir, cpu)
+
+    kops = {}
+    util = {}
+    total_kops = []
+    total_util = []
+    for _ in range(runs):
+        results = run_mdriver(mdriver, tracedir, cpu)
+        ops = secs = 0.0
+        for trace, r in results.items():
+            kops.setdefault(trace, []).append(r["ops"] / r["secs"] / 1e3)
+            util.setdefault(trace, []).append(r["util"])
+            ops += r["ops"]
+            secs += r["secs"]
+        total_kops.append(ops / secs / 1e3)
+        total_util.append(sum(r["util"] for r in results.values()) /
+                          len(results))
+
+    return {
+        "meta": {"mdriver": mdriver, "tracedir": tracedir, "runs": runs,
+                 "cpu": cpu, "host": platform.node(),
+                 "time": time.strftime("%Y-%m-%dT%H:%M:%S")},
+        "traces": {t: {"kops": summarize(kops[t]),
+                       "util": summarize(util[t])} for t in sorted(kops)},
+        "total": {"kops": summarize(total_kops),
+                  "util": summarize(total_util)},
+    }
+
+#
+# compare - return the list of regressions of current against baseline.
+#     Throughput regresses when it drops by more than thru_threshold
+#     percent and the drop is larger than the two confidence intervals
+#     combined; utilization is deterministic and is compared directly.
+#
+def compare(current, baseline, thru_threshold, util_threshold):
+    regressions = []
+    rows = [("Total", current["total"], baseline["total"])]
+    for t, cur in current["traces"].items():
+        if t in baseline["traces"]:
+            rows.append((t, cur, baseline["traces"][t]))
+
+    print("\n%-20s %20s %20s %8s %8s" %
+          ("trace", "Kops (base)", "Kops (now)", "dKops", "dutil"))
+    for name, cur, base in rows:
+        ck, bk = cur["kops"], base["kops"]
+        cu, bu = cur["util"]["mean"], base["util"]["mean"]
+        dk = 100.0 * (ck["mean"] - bk["mean"]) / bk["mean"]
+        du = 100.0 * (cu - bu)
+        flag = ""
+        if (dk < -thru_threshold and
+                bk["mean"] - ck["mean"] > bk["ci95"] + ck["ci95"]):
+            regressions.append("%s throughput %.1f%%" % (name, dk))
+            flag = " <- thru"
+        if du < -util_threshold:
+            regressions.append("%s utilization %.2f points" % (name, du))
+            flag += " <- util"
+        print("%-20s %12.0f +-%6.0f %12.0f +-%6.0f %+7.1f%% %+7.2f%s" %
+              (name, bk["mean"], bk["ci95"], ck["mean"], ck["ci95"],
+               dk, du, flag))
+    return regressions
+
+#
+# main - Main function
+#
+def main():
+    p = optparse.OptionParser()
+    p.add_option("-m", "--mdriver", default="./mdriver",
+                 help="driver binary to benchmark [%default]")
+    p.add_option("-t", "--tracedir", default="traces/",
+                 help="trace corpus directory [%default]")
+    p.add_option("-n", "--runs", type="int", default=10,
+                 help="measured runs [%default]")
+    p.add_option("-w", "--warmup", type="int", default=1,
+                 help="unmeasured warmup runs [%default]")
+    p.add_option("-c", "--cpu", type="int", default=None,
+                 help="CPU to pin mdriver to [last allowed CPU]")
+    p.add_option("-o", "--output", default="bench-results.json",
+                 help="where to write the JSON results [%default]")
+    p.add_option("-b", "--baseline", default=None,
+                 help="baseline JSON to compare against")
+    p.add_option("-s", "--save-baseline", default=None,
+                 help="also store the results as a new baseline")
+    p.add_option("--threshold", type="float", default=5.0,
+                 help="throughput regression threshold in %% [%default]")
+    p.add_option("--util-threshold", type="float", default=0.5,
+                 help="utilization regression threshold in points "
+                      "[%default]")
+    opts, args = p.parse_args()
+
+    if opts.runs < 1:
+        p.error("--runs must be at least 1")
+    cpu = opts.cpu
+    if cpu is None and hasattr(os, "sched_getaffinity"):
+        cpu = max(os.sched_getaffinity(0))
+
+    results = benchmark(opts.mdriver, opts.tracedir, opts.runs,
+                        opts.warmup, cpu)
+
+    print("%-20s %20s %16s" % ("trace", "Kops", "util"))
+    for t, r in list(results["traces"].items()) + [("Total",
+                                                    results["total"])]:
+        print("%-20s %12.0f +-%6.0f %9.2f%% +-%4.2f" %
+              (t, r["kops"]["mean"], r["kops"]["ci95"],
+               100 * r["util"]["mean"], 100 * r["util"]["ci95"]))
+
+    with open(opts.output, "w") as f:
+        json.dump(results, f, indent=2)
+    if opts.save_baseline:
+        with open(opts.save_baseline, "w") as f:
+            json.dump(results, f, indent=2)
+
+    if opts.baseline:
+        with open(opts.baseline) as f:
+            baseline = json.load(f)
+        missing = set(baseline["traces"]) ^ set(results["traces"])
+        if missing:
+            print("warning: trace corpus differs from the baseline: %s" %
+                  ", ".join(sorted(missing)))
+        regressions = compare(results, baseline, opts.threshold,
+                              opts.util_threshold)
+        if regressions:
+            print("\nREGRESSION: " + "; ".join(regressions))
+            sys.exit(1)
+        print("\nNo regressions.")
+
+if __name__ == "__main__":
+    main()
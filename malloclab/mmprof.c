@@ -0,0 +1,345 @@
+/*
+ * mmprof.c - Sampling heap profiler for the mm.c allocator.
+ *
+ * Allocations are sampled geometrically, as in tcmalloc: the gap in
+ * bytes between two samples is drawn from an exponential distribution
+ * whose mean is the sampling rate, so every allocated byte has the same
+ * chance of being sampled and the cost per request is a subtraction.
+ * A sampled request records its size and backtrace; frees of sampled
+ * payloads are tracked so the profile knows what is still live.
+ *
+ * The profile is written in the legacy gperftools heap format
+ * ("heap_v2"), which pprof reads and unsamples by itself:
+ *
+ *	unix> MM_PROF_RATE=65536 ./mdriver-prof -f short1-bal.rep
+ *	unix> pprof --text ./mdriver-prof mm.0001.heap
+ *
+ * A profile is dumped at exit and each time SIGUSR2 is received. The
+ * signal handler only sets a flag; the dump itself happens on the next
+ * mm_malloc or mm_free, where it is safe to do I/O.
+ *
+ * Environment:
+ *   MM_PROF_RATE  mean bytes between samples (default 524288)
+ *   MM_PROF_FILE  prefix of the dump files (default "mm")
+ *
+ * All bookkeeping lives in fixed static tables so that the profiler
+ * never calls back into an allocator.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+#include <execinfo.h>
+
+#include "mmprof.h"
+
+#define DEFAULT_RATE  (512 * 1024)
+#define MAX_DEPTH     32           /* frames kept per backtrace */
+#define SKIP_FRAMES   1            /* drop prof_malloc itself */
+#define MAX_BUCKETS   4096         /* distinct allocation sites (2^k) */
+#define MAX_SAMPLES   65536        /* live sampled payloads (2^k) */
+#define TOMBSTONE     ((void *)1)
+
+/* Aggregated statistics for one allocation site (backtrace) */
+typedef struct {
+    void *pcs[MAX_DEPTH];
+    int depth;
+    unsigned hash;
+    long long alloc_objs, alloc_bytes;
+    long long inuse_objs, inuse_bytes;
+} bucket_t;
+
+/* A live sampled payload */
+typedef struct {
+    void *ptr;
+    size_t size;
+    int bucket;
+} sample_t;
+
+static bucket_t buckets[MAX_BUCKETS];
+static int num_buckets = 0;
+static sample_t samples[MAX_SAMPLES];
+static int num_samples = 0;       /* live entries, tombstones excluded */
+static int num_used = 0;          /* live entries plus tombstones */
+static long long dropped = 0;     /* samples lost to full tables */
+
+static int initialized = 0;
+static double rate = DEFAULT_RATE;
+static long long bytes_left = 0;
+static unsigned long long rng_state;
+static char prefix[256] = "mm";
+static int dump_seq = 0;
+static volatile sig_atomic_t dump_requested = 0;
+
+/*
+ * next_random - xorshift64*, kept local so sampling does not disturb
+ *     the rand() sequence of the program being profiled.
+ */
+static unsigned long long next_random(void)
+{
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 2685821657736338717ULL;
+}
+
+/*
+ * next_interval - bytes until the next sample, exponentially distributed
+ *     with mean rate.
+ */
+static long long next_interval(void)
+{
+    double u = ((next_random() >> 11) + 1.0) / 9007199254740993.0;
+    return (long long)(-log(u) * rate) + 1;
+}
+
+static void sigusr2_handler(int sig)
+{
+    dump_requested = 1;
+}
+
+static void dump_at_exit(void)
+{
+    char filename[300];
+
+    sprintf(filename, "%s.%04d.heap", prefix, ++dump_seq);
+    prof_dump(filename);
+}
+
+static void prof_init(void)
+{
+    char *env;
+    void *warmup[1];
+    struct sigaction sa, old;
+
+    initialized = 1;
+
+    if ((env = getenv("MM_PROF_RATE")) != NULL && atof(env) >= 1)
+        rate = atof(env);
+    if ((env = getenv("MM_PROF_FILE")) != NULL && *env != '\0') {
+        strncpy(prefix, env, sizeof(prefix) - 1);
+        prefix[sizeof(prefix) - 1] = '\0';
+    }
+
+    rng_state = ((unsigned long long)time(NULL) << 20) ^ getpid() ^ 0x9e3779b97f4a7c15ULL;
+    bytes_left = next_interval();
+
+    /* The first backtrace() may load libgcc, so get it over with now */
+    backtrace(warmup, 1);
+
+    /* Don't steal SIGUSR2 from a program that already handles it */
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = sigusr2_handler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    if (sigaction(SIGUSR2, NULL, &old) == 0 && old.sa_handler == SIG_DFL)
+        sigaction(SIGUSR2, &sa, NULL);
+
+    atexit(dump_at_exit);
+}
+
+static void check_dump(void)
+{
+    if (dump_requested) {
+        dump_requested = 0;
+        dump_at_exit();
+    }
+}
+
+static unsigned hash_pcs(void **pcs, int depth)
+{
+    unsigned h = 2166136261u;
+    int i;
+
+    for (i = 0; i < depth; i++)
+        h = (h ^ (unsigned)(unsigned long)pcs[i]) * 16777619u;
+    return h;
+}
+
+static unsigned hash_ptr(void *ptr)
+{
+    unsigned long p = (unsigned long)ptr;
+    return (unsigned)((p >> 3) * 2654435761u);
+}
+
+/*
+ * find_bucket - look up (or create) the bucket for a backtrace.
+ *     Returns -1 when the table is full.
+ */
+static int find_bucket(void **pcs, int depth)
+{
+    unsigned h = hash_pcs(pcs, depth);
+    unsigned i = h & (MAX_BUCKETS - 1);
+    bucket_t *b;
+
+    while (buckets[i].depth != 0) {
+        b = &buckets[i];
+        if (b->hash == h && b->depth == depth &&
+            memcmp(b->pcs, pcs, depth * sizeof(void *)) == 0)
+            return i;
+        i = (i + 1) & (MAX_BUCKETS - 1);
+    }
+
+    /* Keep the table at most 3/4 full so probes stay short */
+    if (num_buckets >= MAX_BUCKETS / 4 * 3)
+        return -1;
+
+    b = &buckets[i];
+    memcpy(b->pcs, pcs, depth * sizeof(void *));
+    b->depth = depth;
+    b->hash = h;
+    num_buckets++;
+    return i;
+}
+
+static void record_sample(void *ptr, size_t size, void **pcs, int depth)
+{
+    unsigned i;
+    int bucket;
+
+    if (depth <= 0 || num_used >= MAX_SAMPLES / 4 * 3 ||
+        (bucket = find_bucket(pcs, depth)) < 0) {
+        dropped++;
+        return;
+    }
+
+    buckets[bucket].alloc_objs++;
+    buckets[bucket].alloc_bytes += size;
+    buckets[bucket].inuse_objs++;
+    buckets[bucket].inuse_bytes += size;
+
+    i = hash_ptr(ptr) & (MAX_SAMPLES - 1);
+    while (samples[i].ptr != NULL && samples[i].ptr != TOMBSTONE)
+        i = (i + 1) & (MAX_SAMPLES - 1);
+    if (samples[i].ptr == NULL)
+        num_used++;
+    samples[i].ptr = ptr;
+    samples[i].size = size;
+    samples[i].bucket = bucket;
+    num_samples++;
+}
+
+/*
+ * prof_malloc - account for size bytes just handed out at ptr
+ */
+void __attribute__((noinline)) prof_malloc(void *ptr, size_t size)
+{
+    void *pcs[MAX_DEPTH + SKIP_FRAMES];
+    int depth;
+
+    if (!initialized)
+        prof_init();
+    check_dump();
+
+    if (ptr == NULL)
+        return;
+
+    bytes_left -= (long long)size;
+    if (bytes_left > 0)
+        return;
+    bytes_left = next_interval();
+
+    depth = backtrace(pcs, MAX_DEPTH + SKIP_FRAMES) - SKIP_FRAMES;
+    record_sample(ptr, size, pcs + SKIP_FRAMES, depth);
+}
+
+/*
+ * prof_free - forget ptr if it was a sampled payload
+ */
+void prof_free(void *ptr)
+{
+    unsigned i;
+    bucket_t *b;
+
+    if (!initialized)
+        return;
+    check_dump();
+
+    if (ptr == NULL || num_samples == 0)
+        return;
+
+    i = hash_ptr(ptr) & (MAX_SAMPLES - 1);
+    while (samples[i].ptr != NULL) {
+        if (samples[i].ptr == ptr) {
+            b = &buckets[samples[i].bucket];
+            b->inuse_objs--;
+            b->inuse_bytes -= samples[i].size;
+            samples[i].ptr = TOMBSTONE;
+            num_samples--;
+            return;
+        }
+        i = (i + 1) & (MAX_SAMPLES - 1);
+    }
+}
+
+/*
+ * prof_reset_inuse - drop every live sample but keep the allocation
+ *     totals. The driver calls mm_init once per trace on a reset heap,
+ *     which would otherwise leave stale payloads behind.
+ */
+void prof_reset_inuse(void)
+{
+    int i;
+
+    for (i = 0; i < MAX_BUCKETS; i++) {
+        buckets[i].inuse_objs = 0;
+        buckets[i].inuse_bytes = 0;
+    }
+    memset(samples, 0, sizeof(samples));
+    num_samples = 0;
+    num_used = 0;
+}
+
+/*
+ * prof_dump - write the profile in the gperftools heap format, followed
+ *     by the memory map pprof needs to symbolize the addresses.
+ */
+int prof_dump(const char *filename)
+{
+    FILE *fp, *maps;
+    long long inuse_objs = 0, inuse_bytes = 0;
+    long long alloc_objs = 0, alloc_bytes = 0;
+    char buf[4096];
+    size_t n;
+    int i, j;
+
+    if ((fp = fopen(filename, "w")) == NULL) {
+        perror(filename);
+        return -1;
+    }
+
+    for (i = 0; i < MAX_BUCKETS; i++) {
+        inuse_objs += buckets[i].inuse_objs;
+        inuse_bytes += buckets[i].inuse_bytes;
+        alloc_objs += buckets[i].alloc_objs;
+        alloc_bytes += buckets[i].alloc_bytes;
+    }
+
+    fprintf(fp, "heap profile: %6lld: %8lld [%6lld: %8lld] @ heap_v2/%.0f\n",
+            inuse_objs, inuse_bytes, alloc_objs, alloc_bytes, rate);
+    for (i = 0; i < MAX_BUCKETS; i++) {
+        bucket_t *b = &buckets[i];
+        if (b->depth == 0)
+            continue;
+        fprintf(fp, "%6lld: %8lld [%6lld: %8lld] @",
+                b->inuse_objs, b->inuse_bytes, b->alloc_objs, b->alloc_bytes);
+        for (j = 0; j < b->depth; j++)
+            fprintf(fp, " %p", b->pcs[j]);
+        fprintf(fp, "\n");
+    }
+
+    fprintf(fp, "\nMAPPED_LIBRARIES:\n");
+    if ((maps = fopen("/proc/self/maps", "r")) != NULL) {
+        while ((n = fread(buf, 1, sizeof(buf), maps)) > 0)
+            fwrite(buf, 1, n, fp);
+        fclose(maps);
+    }
+    fclose(fp);
+
+    if (dropped > 0)
+        fprintf(stderr, "mmprof: %lld samples dropped, tables full\n", dropped);
+    return 0;
+}
@@ -0,0 +1,19 @@
+/*
+ * mmprof.h - Sampling heap profiler for the mm.c allocator
+ */
+#ifndef __MMPROF_H_
+#define __MMPROF_H_
+
+#include <stddef.h>
+
+/* Called by mm.c (when built with HEAP_PROFILE) for every request */
+void prof_malloc(void *ptr, size_t size);
+void prof_free(void *ptr);
+
+/* Forget the live samples, e.g. when mm_init starts a fresh heap */
+void prof_reset_inuse(void);
+
+/* Write a pprof-compatible heap profile to the given file */
+int prof_dump(const char *filename);
+
+#endif /* __MMPROF_H_ */